@@ -0,0 +1,22 @@
+#include "Diagnostics.h"
+
+#include <llvm/Support/Timer.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+// Per-thread so that concurrently running analyses don't interleave their output.
+static thread_local raw_ostream *destination = nullptr;
+
+raw_ostream &diags() {
+  return destination ? *destination : errs();
+}
+
+void redirect_diags(raw_ostream *stream) {
+  destination = stream;
+}
+
+TimerGroup &dimens_timers() {
+  static TimerGroup group("Dimensional analysis phases");
+  return group;
+}
@@ -0,0 +1,18 @@
+#ifndef DIAGNOSTICS_H_
+#define DIAGNOSTICS_H_
+
+namespace llvm {
+class TimerGroup;
+class raw_ostream;
+}
+
+// Stream receiving the passes' progress and diagnostic messages on the calling thread; errs() unless redirected.
+llvm::raw_ostream &diags();
+
+// Redirect this thread's diagnostics, or restore the default by passing nullptr.
+void redirect_diags(llvm::raw_ostream *);
+
+// Group for the passes' phase timers, which are reported along with -time-passes.
+llvm::TimerGroup &dimens_timers();
+
+#endif
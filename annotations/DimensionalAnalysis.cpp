@@ -1,23 +1,43 @@
 #include "DimensionalAnalysis.h"
 
+#include <llvm/ADT/SCCIterator.h>
+#include <llvm/ADT/Statistic.h>
+#include <llvm/Analysis/CallGraph.h>
+#include <llvm/IR/CallSite.h>
 #include <llvm/IR/DebugLoc.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Operator.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Format.h>
 #include <llvm/Support/raw_ostream.h>
-#include <lapacke.h>
+#include <llvm/Transforms/Utils/PromoteMemToReg.h>
+#include <cxxabi.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <set>
+#include <thread>
 
+#include "Diagnostics.h"
 #include "TraceVariablesNg.h"
 
 using namespace llvm;
-using std::min;
+using std::iota;
 using std::map;
-using std::set;
 using std::move;
+using std::pair;
 using std::string;
+using std::thread;
+using std::unordered_map;
 using std::unordered_set;
 using std::vector;
 
@@ -27,10 +47,139 @@ using std::vector;
 #define OFFSET_START_BIT         48
 #define OFFSET_BIT_WIDTH(ptr_ty) (8 * sizeof(ptr_ty) - OFFSET_START_BIT)
 
+#define DEBUG_TYPE "dimens"
+
+STATISTIC(NumRows, "Number of equations (matrix rows)");
+STATISTIC(NumCols, "Number of variables (matrix columns)");
+STATISTIC(NumNonzeros, "Number of nonzero matrix coefficients");
+STATISTIC(NumTemporaries, "Number of temporary (non-source) variables");
+STATISTIC(NumSubsystems, "Number of independent subsystems solved separately");
+STATISTIC(NumReusedSubsystems, "Number of subsystems whose solutions were found in the cache");
+STATISTIC(NumPresolvedRows, "Number of equations eliminated by presolve before solving");
+STATISTIC(NumTransplants, "Number of functions whose equations were carried over from one of the same shape");
+
+static cl::opt<bool> print_function_costs("dimens-function-costs",
+    cl::desc("Report how many equations and columns each function contributed"));
+
+static cl::opt<bool> no_dedup("dimens-no-dedup",
+    cl::desc("Analyze every function from scratch, even ones shaped just like another (e.g. template instantiations)"));
+
+static cl::opt<bool> no_forwarding("dimens-no-forwarding",
+    cl::desc("Treat loads from local variables' stack slots as separate variables, as if mem2reg hadn't been run"));
+
+static cl::opt<bool> points_to("dimens-points-to",
+    cl::desc("Give all pointers that might point to the same place (by Steensgaard's analysis) a single memory column"));
+
+static cl::opt<unsigned> mem_budget("dimens-mem-budget",
+    cl::desc("Memory available for solving, in MiB; bigger systems are split up and solved more frugally (default: unlimited)"),
+    cl::value_desc("MiB"), cl::init(0));
+
+static cl::opt<string> solver_choice("dimens-solver",
+    cl::desc("Solve every independent subsystem with the named solver (dense, sparse, out-of-core or small) instead of choosing automatically"),
+    cl::value_desc("name"));
+
+// Solvers to try, most accurate first, when the whole system won't fit in the memory budget.
+static const char *const fallbacks[] = {"dense", "sparse", "out-of-core"};
+
+// Whether a solver needing the given number of bytes can be used within the budget, if one was given at all.
+// An estimate of SIZE_MAX means the solver can't take the system at all, whatever the budget.
+static bool fits(std::size_t need, std::size_t budget) {
+  return need != (std::size_t) -1 && (!mem_budget || need <= budget);
+}
+
+// Solver with a fixed-size kernel for each small number of columns, which is the cheapest way to solve tiny systems.
+static const char *const small_solver = "small";
+
+static cl::opt<bool> no_presolve("dimens-no-presolve",
+    cl::desc("Hand the solvers each subsystem as is, without first eliminating the rows and columns that settle themselves"));
+
+static cl::opt<bool> intraprocedural("dimens-intraprocedural",
+    cl::desc("Analyze each function on its own, with its own copy of every global and field, solving them all in parallel"));
+
+static cl::opt<unsigned> threads("dimens-threads",
+    cl::desc("Number of functions to solve concurrently with -dimens-intraprocedural (default: one per core)"),
+    cl::init(0));
+
+static cl::opt<bool> hierarchical_blame("dimens-hierarchical-blame",
+    cl::desc("Look for faulty source lines by ruling out whole functions, then blocks, then halves of what's left"));
+
+static cl::opt<bool> streaming("dimens-stream",
+    cl::desc("Solve and blame independent subsystems smallest first, printing each one's findings as soon as they're known"));
+
+static cl::opt<bool> incremental("dimens-incremental",
+    cl::desc("Solve while traversing, reporting each dimensionless variable as soon as it's found and blaming the equation that first made it so"));
+
+static cl::opt<unsigned> blame_timeout("dimens-blame-timeout",
+    cl::desc("Give up looking for faulty source lines after this many seconds, reporting the ones found so far (default: no limit)"),
+    cl::value_desc("seconds"), cl::init(0));
+
+static cl::list<string> focus_names("dimens-focus", cl::CommaSeparated,
+    cl::desc("Solve and blame only the equations connected, however indirectly, to these source variables"),
+    cl::value_desc("scope::name,..."));
+
+static cl::opt<string> matrix_path("dimens-matrix",
+    cl::desc("Dump the equation matrix in Matrix Market coordinate format to this file, and its column names to <file>.cols"),
+    cl::value_desc("file"));
+
+// When blame has to stop, if it starts now.
+static std::chrono::steady_clock::time_point blame_deadline() {
+  if(!blame_timeout)
+    return std::chrono::steady_clock::time_point::max();
+  return std::chrono::steady_clock::now() + std::chrono::seconds(blame_timeout);
+}
+
+static unsigned workers() {
+  if(!intraprocedural)
+    // Otherwise the subsystems have to take turns, or they might not fit in the memory budget.
+    return 1;
+  unsigned res = threads ? threads : thread::hardware_concurrency();
+  return res ? res : 1;
+}
+
+// Run the job on every index below the count, spread across the workers.
+static void parallel_for(std::size_t count, const std::function<void (std::size_t)> &job) {
+  unsigned pool_size = std::min<std::size_t>(workers(), count);
+  if(pool_size <= 1) {
+    for(std::size_t index = 0; index < count; ++index)
+      job(index);
+    return;
+  }
+
+  std::atomic<std::size_t> next(0);
+  vector<thread> pool;
+  for(unsigned worker = 0; worker < pool_size; ++worker)
+    pool.emplace_back([&] {
+      // The solvers hardly have anything to say, and it would come out jumbled anyway.
+      redirect_diags(&nulls());
+      for(std::size_t index; (index = next++) < count;)
+        job(index);
+    });
+  for(thread &worker : pool)
+    worker.join();
+}
+
 static bool is_const(const Value *obj) {
   return obj && isa<Constant>(*obj) && !isa<GlobalValue>(*obj) && !isa<ConstantExpr>(*obj);
 }
 
+// Opcode standing for everything that relates its operands the same way, so that shapes can ignore types.
+static unsigned role(unsigned opcode) {
+  switch(opcode) {
+    case Instruction::FAdd:
+      return Instruction::Add;
+    case Instruction::FSub:
+      return Instruction::Sub;
+    case Instruction::FMul:
+      return Instruction::Mul;
+    case Instruction::UDiv:
+    case Instruction::FDiv:
+      return Instruction::SDiv;
+    case Instruction::FCmp:
+      return Instruction::ICmp;
+  }
+  return Instruction::isCast(opcode) ? (unsigned) Instruction::BitCast : opcode;
+}
+
 static string soff_str(const StructType &type, uint64_t offset) {
   string res;
   raw_string_ostream stm(res);
@@ -47,17 +196,17 @@ static string val_str(const Value &obj) {
   return res;
 }
 
-const TraceVariablesNg *dimens_var::lookup = nullptr;
+thread_local const TraceVariablesNg *dimens_var::lookup = nullptr;
 
-dimens_var::dimens_var(const void *hash, string &&str, bool constant) :
+dimens_var::dimens_var(const void *hash, kind what, bool constant) :
     hash((unsigned long) hash),
-    str(move(str)),
+    what(what),
     constant(constant),
     svar(nullptr) {}
 
 dimens_var::dimens_var(const StructType &typ, const APInt &off) :
     dimens_var(&typ,
-        soff_str(typ, off.getZExtValue())) {
+        FIELD) {
   assert((off.getActiveBits() <= OFFSET_BIT_WIDTH(hash) || !~(off.getSExtValue() >> OFFSET_BIT_WIDTH(hash))) && "ERROR: Struct offset too large to store!");
   // Make sure we're distinguished from the object itself, even if our offset is zero!
   hash |= 0x1;
@@ -67,11 +216,11 @@ dimens_var::dimens_var(const StructType &typ, const APInt &off) :
 
 dimens_var::dimens_var(const DIVariable &var) :
     dimens_var(&var,
-        TraceVariablesNg::str(var)) {}
+        SOURCE) {}
 
 dimens_var::dimens_var(Value &val) :
     dimens_var(&val,
-        val_str(val),
+        VALUE,
         is_const(&val)) {
   assert(lookup);
 
@@ -81,8 +230,6 @@ dimens_var::dimens_var(Value &val) :
     svar = *lookup->vars.at(&val).begin();
 }
 
-dimens_var::~dimens_var() = default;
-
 bool dimens_var::operator==(const dimens_var &other) const {
   return this->hash == other.hash;
 }
@@ -91,10 +238,6 @@ dimens_var::operator unsigned long() const {
   return hash;
 }
 
-dimens_var::operator const string &() const {
-  return str;
-}
-
 dimens_var::operator DIVariable *() const {
   return svar;
 }
@@ -103,27 +246,124 @@ bool dimens_var::isa_constant() const {
   return constant;
 }
 
+dimens_var::kind dimens_var::which() const {
+  return what;
+}
+
+Value *dimens_var::value() const {
+  return what == VALUE ? (Value *) hash : nullptr;
+}
+
+string dimens_var::str() const {
+  return str(hash, what);
+}
+
+string dimens_var::str(unsigned long hash, kind what) {
+  switch(what) {
+    case VALUE:
+      return val_str(*(const Value *) hash);
+    case SOURCE:
+      return TraceVariablesNg::str(*(const DIVariable *) hash);
+    case FIELD:
+      // Unpack the struct type and offset.
+      return soff_str(*(const StructType *) (hash & ((1UL << OFFSET_START_BIT) - 1) & ~0x1UL), hash >> OFFSET_START_BIT);
+  }
+  return "";
+}
+
+variable_table::size_type variable_table::size() const {
+  return keys.size();
+}
+
+void variable_table::reserve(size_type count) {
+  keys.reserve(count);
+  kinds.reserve(count);
+  temporaries.reserve(count);
+}
+
+void variable_table::push_back(const dimens_var &var, bool temporary) {
+  keys.push_back(var);
+  kinds.push_back(var.which());
+  temporaries.push_back(temporary);
+}
+
+bool variable_table::temporary(size_type col) const {
+  return temporaries[col];
+}
+
+const string &variable_table::name(size_type col) const {
+  if(names.size() <= col)
+    names.resize(keys.size());
+  if(names[col].empty())
+    names[col] = dimens_var::str(keys[col], kinds[col]);
+  return names[col];
+}
+
 char DimensionalAnalysis::ID = 0;
 
 DimensionalAnalysis::DimensionalAnalysis() :
     ModulePass(ID),
     module(nullptr),
     first_temporary(-1),
-    is_temporary([this](index_type index) {return index >= first_temporary && !(variables[index] & 0x1);}),
+    is_temporary([this](index_type index) {return variables.temporary(index);}),
     indirections(),
     variables(),
     indices(),
+    promotable(),
+    aliases(),
+    alias_columns(),
+    arena(),
     equations(),
     locations(),
+    blocks(),
+    current_block(nullptr),
     dimensionless(),
     bad_eqns(),
-    groupings(nullptr) {}
+    lines_checked(0),
+    lines_total(0),
+    groupings(nullptr),
+    system(),
+    subsystems(),
+    row_homes(),
+    presolved(),
+    failure(),
+    memo(nullptr),
+    early(nullptr),
+    progress(),
+    forced_by(),
+    summaries(),
+    current_scc(),
+    function_rows(),
+    costs(),
+    templates(),
+    recording(nullptr),
+    nesting(0),
+    traversal_timer("IR traversal", dimens_timers()),
+    summary_timer("Function summaries", dimens_timers()),
+    assembly_timer("Matrix assembly", dimens_timers()),
+    solve_timer("calcDimensionless", dimens_timers()),
+    blame_timer("getBadEqns", dimens_timers()) {}
 
 void DimensionalAnalysis::getAnalysisUsage(llvm::AnalysisUsage &info) const {
   info.addRequired<TraceVariablesNg>();
+  info.addRequired<CallGraphWrapperPass>();
 }
 
 bool DimensionalAnalysis::runOnModule(llvm::Module &module) {
+  if(incremental && focus_names.size()) {
+    // Solving as we go reports each variable before there's a finished system to take a slice of.
+    failure = "ERROR: -dimens-focus can't be combined with -dimens-incremental";
+    diags() << failure << '\n';
+    return false;
+  }
+  if(hierarchical_blame && (memo || streaming || intraprocedural)) {
+    // Those blame each subsystem on its own, one line at a time.
+    failure = "ERROR: -dimens-hierarchical-blame can't be combined with -dimens-stream or -dimens-intraprocedural, or "
+        "used by the server";
+    diags() << failure << '\n';
+    return false;
+  }
+
   // We cannot allow modification of this structure or the (parallel) indices won't be stable!
   const TraceVariablesNg &groupings = getAnalysis<TraceVariablesNg>();
   this->groupings = &groupings;
@@ -142,30 +382,68 @@ bool DimensionalAnalysis::runOnModule(llvm::Module &module) {
       for(auto lhs = revmap.second.begin(), end = revmap.second.end(); lhs != end; ++lhs) {
         auto rhs = lhs;
         for(++rhs; rhs != end; ++rhs) {
-          errs() << "Source variable analysis revealed that:";
+          diags() << "Source variable analysis revealed that:";
           instruction_setequal(**lhs, **rhs);
         }
       }
 
-  // Process the program's instructions.
-  for(Function &function : module)
-    for(BasicBlock &block : function.getBasicBlockList())
-      for(Instruction &inst : block.getInstList())
-        instruction_opdecode(inst);
-
-  // Make sure no temporaries were erroneously added for registers already associated with a source variable.
-  for(dimens_var each : variables)
-    assert(!(DIVariable *) each);
+  if(points_to)
+    // Calls only spread aliasing if we're following them anyway.
+    aliases.build(module, !intraprocedural);
+
+  // Process the program's instructions, visiting callees before their callers so each call site can use a summary.
+  CallGraph &calls = getAnalysis<CallGraphWrapperPass>().getCallGraph();
+  for(scc_iterator<CallGraph *> scc = scc_begin(&calls); !scc.isAtEnd(); ++scc) {
+    vector<Function *> members;
+    for(CallGraphNode *node : *scc)
+      if(Function *function = node->getFunction())
+        if(!function->isDeclaration())
+          members.push_back(function);
+    if(members.size())
+      analyze_scc(members);
+  }
 
-  // Smooth the equations matrix's jagged boundaries.
-  index_type cols = variables.size();
-  for(vector<int> &row : equations) {
-    assert(row.size() <= cols);
-    row.resize(cols);
+  // Pick up anything the call graph couldn't reach, such as unreferenced internal functions.
+  for(Function &function : module)
+    if(!function.isDeclaration() && !summaries.count(&function))
+      analyze_scc({&function});
+
+  {
+    TimeRegion timing(TimePassesIsEnabled ? &assembly_timer : nullptr);
+
+    // Gather the nonzero coefficients into sparse rows for the solvers.
+    index_type cols = variables.size();
+    system.cols = cols;
+    system.rows.clear();
+    system.rows.reserve(equations.size());
+    for(sparse_equation row : equations) {
+      assert(row.empty() || row.back().first < cols);
+      system.rows.emplace_back(row.begin(), row.end());
+    }
+    NumNonzeros += system.nonzeros();
+    NumRows += equations.size();
+    NumCols += cols;
+    NumTemporaries += cols - first_temporary;
   }
+  if(focus_names.size())
+    focus();
 
   // Perform the actual dimensionality calculations.
-  calcDimensionless();
+  {
+    TimeRegion timing(TimePassesIsEnabled ? &solve_timer : nullptr);
+    calcDimensionless();
+  }
+  if(blame_timeout && failure.empty()) {
+    // Blame might not finish, so get the main result out now in case we're stopped.
+    raw_ostream &stream = early ? *early : outs();
+    print_dimensionless(stream);
+    stream << '\n';
+    stream.flush();
+  }
+  {
+    TimeRegion timing(TimePassesIsEnabled ? &blame_timer : nullptr);
+    getBadEqns();
+  }
 
   // Trim out temporaries to leave only source variables in our output.
   dimensionless.erase(remove_if(dimensionless.begin(), dimensionless.end(), is_temporary), dimensionless.end());
@@ -173,20 +451,23 @@ bool DimensionalAnalysis::runOnModule(llvm::Module &module) {
 }
 
 void DimensionalAnalysis::print(llvm::raw_ostream &stream, const llvm::Module *module) const {
-  // Here's the matrix we sent to the solver.
-  for(const dimens_var &each : variables)
-    stream << (const string &) each << ' ';
-  stream << '\n';
-  for(const vector<int> &row : equations) {
-    for(index_type ix = 0, sz = row.size(); ix < sz; ++ix)
-      stream << format_decimal(row[ix], ((const string &) variables[ix]).size()) << ' ';
-    stream << '\n';
+  // Here's the matrix we sent to the solver, if anyone asked for it.
+  if(!matrix_path.empty())
+    dump_matrix(matrix_path);
+  if(print_function_costs)
+    print_costs(stream);
+
+  if(failure.size()) {
+    stream << failure << '\n';
+    return;
   }
 
-  // And the "winners" are...
-  stream << "Found " << dimensionless.size() << " dimensionless variables:\n";
-  for(int index : dimensionless)
-    stream << (const string &) variables[index] << '\n';
+  if(presolved.rows_before)
+    stream << "Presolve reduced " << presolved.rows_before << " equations in " << presolved.cols_before << " variables to "
+        << presolved.rows_after << " equations in " << presolved.cols_after << " variables\n\n";
+  if(!blame_timeout)
+    // Otherwise it's already been printed, ahead of blame.
+    print_dimensionless(stream);
 
   if(dimensionless.size()) {
     // Get ready for the big reveal!
@@ -204,76 +485,412 @@ void DimensionalAnalysis::print(llvm::raw_ostream &stream, const llvm::Module *m
         }
         // (Omitted) else: This equation corresponds to an instruction with no location debugging annotation.
       } else
-        errs() << "WARNING: Untraceable equation " << index << " is a suspect.\n";
+        diags() << "WARNING: Untraceable equation " << index << " is a suspect.\n";
+
+    if(lines_checked < lines_total)
+      stream << "Only " << lines_checked << " of " << lines_total << " source lines (the most suspicious ones) were checked "
+          << "within the -dimens-blame-timeout of " << blame_timeout << " seconds, so this list may be incomplete.\n";
   }
 }
 
-void DimensionalAnalysis::calcDimensionless() {
-  int rows = equations.size();
-  int cols = equations[0].size();
+void DimensionalAnalysis::print_dimensionless(raw_ostream &stream) const {
+  // And the "winners" are...
+  // (If blame hasn't run yet, the temporaries haven't been trimmed out.)
+  stream << "Found " << count_if(dimensionless.begin(), dimensionless.end(), [this](int index) {return !is_temporary(index);})
+      << " dimensionless variables:\n";
+  for(int index : dimensionless)
+    if(!is_temporary(index))
+      stream << variables.name(index) << '\n';
+}
+
+void DimensionalAnalysis::reuse(SolutionCache *cache) {
+  memo = cache;
+}
+
+void DimensionalAnalysis::report_early(raw_ostream *stream) {
+  early = stream;
+}
 
-  char cN = 'N';
-  char cA = 'A';
+void DimensionalAnalysis::dump_matrix(const string &path) const {
+  std::error_code err;
+  raw_fd_ostream matrix(path, err, sys::fs::F_None);
+  if(err) {
+    diags() << "ERROR: Couldn't write equation matrix to " << path << ": " << err.message() << '\n';
+    return;
+  }
+
+  // The header has to give the number of entries up front.
+  vector<int>::size_type nonzeros = 0;
+  for(sparse_equation row : equations)
+    nonzeros += row.size();
+  matrix << "%%MatrixMarket matrix coordinate integer general\n";
+  matrix << "% Column names are listed in " << path << ".cols\n";
+  matrix << equations.size() << ' ' << variables.size() << ' ' << nonzeros << '\n';
+  for(index_type row = 0, rows = equations.size(); row < rows; ++row)
+    for(const equation_term &term : equations[row])
+      matrix << row + 1 << ' ' << term.first + 1 << ' ' << term.second << '\n';
+
+  raw_fd_ostream names(path + ".cols", err, sys::fs::F_Text);
+  if(err) {
+    diags() << "ERROR: Couldn't write column names to " << path << ".cols: " << err.message() << '\n';
+    return;
+  }
+  for(index_type col = 0, cols = variables.size(); col < cols; ++col)
+    names << col + 1 << '\t' << variables.name(col) << '\n';
+}
+
+void DimensionalAnalysis::print_component(raw_ostream &stream, const subsystem &part,
+    vector<subsystem>::size_type ordinal) const {
+  vector<int> found;
+  for(int col : part.dimensionless)
+    if(!is_temporary(part.cols[col]))
+      found.push_back(part.cols[col]);
+  if(found.empty())
+    // Nothing to see here.
+    return;
+
+  stream << "Subsystem " << ordinal << " of " << subsystems.size() << " (" << part.rows.size() << " equations): found "
+      << found.size() << " dimensionless variables:\n";
+  for(int col : found)
+    stream << variables.name(col) << '\n';
+  stream << "Suspect source locations:\n";
+  for(int local : part.culprits)
+    if(const DebugLoc *spot = locations[part.rows[local]])
+      if(*spot) {
+        spot->print(stream);
+        stream << '\n';
+      }
+  stream << '\n';
+}
+
+void DimensionalAnalysis::print_costs(raw_ostream &stream) const {
+  vector<function_cost> by_size = costs;
+  std::sort(by_size.begin(), by_size.end(), [](const function_cost &lhs, const function_cost &rhs) {
+    return lhs.rows > rhs.rows;
+  });
+
+  stream << "Equation system cost by function:\n";
+  stream << "    rows columns nonzeros function\n";
+  for(const function_cost &cost : by_size) {
+    // Demangle so that it's clear which template instantiation is which.
+    string name = cost.function->getName().str();
+    int status;
+    if(char *demangled = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status)) {
+      name = demangled;
+      free(demangled);
+    }
+    stream << format_decimal(cost.rows, 8) << format_decimal(cost.cols, 8) << format_decimal(cost.nonzeros, 9) << ' ' << name << '\n';
+  }
+  stream << '\n';
+}
+
+void DimensionalAnalysis::focus() {
+  // Look up the requested variables' columns. Names aren't unique, since unnamed lexical blocks don't show up in them
+  // (e.g. a local shadowing another in the same function), so each name may stand for several variables.
+  unordered_map<string, vector<index_type>> named;
+  for(index_type col = 0, cols = variables.size(); col < cols; ++col)
+    if(!is_temporary(col))
+      named[variables.name(col)].push_back(col);
+  vector<index_type> work;
+  for(const string &name : focus_names) {
+    auto known = named.find(name);
+    if(known == named.end())
+      diags() << "WARNING: No source variable named " << name << " to focus on\n";
+    else
+      work.insert(work.end(), known->second.begin(), known->second.end());
+  }
+
+  // Everything that shares an equation with one of them, and so on.
+  vector<vector<int>> occurrences(system.cols);
+  for(int row = 0, rows = system.rows.size(); row < rows; ++row)
+    for(const auto &term : system.rows[row])
+      occurrences[term.first].push_back(row);
+  vector<char> reached(system.cols), kept(system.rows.size());
+  for(index_type col : work)
+    reached[col] = true;
+  while(work.size()) {
+    index_type col = work.back();
+    work.pop_back();
+    for(int row : occurrences[col])
+      if(!kept[row]) {
+        kept[row] = true;
+        for(const auto &term : system.rows[row])
+          if(!reached[term.first]) {
+            reached[term.first] = true;
+            work.push_back(term.first);
+          }
+      }
+  }
 
+  // Empty out the rest, which leaves them out of every subsystem.
+  vector<equation_system::row>::size_type slice = 0;
+  for(int row = 0, rows = system.rows.size(); row < rows; ++row)
+    if(kept[row])
+      ++slice;
+    else
+      system.rows[row].clear();
+  diags() << "INFO: Focusing on " << slice << " of " << system.rows.size() << " equations\n";
+}
+
+bool DimensionalAnalysis::plan() {
+  subsystems.clear();
+  row_homes.assign(system.rows.size(), {-1, -1});
+  failure.clear();
+
+  std::size_t budget = (std::size_t) mem_budget << 20;
+  const DimensionlessSolver *forced = nullptr;
+  if(solver_choice.size() && !(forced = DimensionlessSolver::get(solver_choice))) {
+    failure = "ERROR: Unknown solver " + solver_choice + " requested with -dimens-solver";
+    diags() << failure << '\n';
+    return false;
+  }
+
+  const DimensionlessSolver *reference = DimensionlessSolver::get(fallbacks[0]);
+  if(intraprocedural) {
+    // The rows relating a source variable's several values aren't any one function's, so each function gets a copy of
+    // those that only involve columns it uses itself.
+    vector<char> owned(system.rows.size());
+    for(const auto &range : function_rows)
+      fill(owned.begin() + range.first, owned.begin() + range.second, true);
+    unordered_map<equation_system::column, vector<int>> shared;
+    for(int row = 0, rows = system.rows.size(); row < rows; ++row)
+      if(!owned[row])
+        for(const auto &term : system.rows[row])
+          shared[term.first].push_back(row);
+
+    // Extracting each function's rows gives it its own numbering, and thus its own copy of every global and field.
+    for(const auto &range : function_rows) {
+      subsystem part;
+      unordered_set<equation_system::column> mine;
+      for(int row = range.first; row < (int) range.second; ++row)
+        if(system.rows[row].size()) {
+          part.rows.push_back(row);
+          for(const auto &term : system.rows[row])
+            mine.insert(term.first);
+        }
+      if(part.rows.empty())
+        continue;
+
+      std::set<int> relevant;
+      for(equation_system::column col : mine) {
+        auto relations = shared.find(col);
+        if(relations != shared.end())
+          for(int row : relations->second)
+            if(all_of(system.rows[row].begin(), system.rows[row].end(), [&mine](const equation_system::row::value_type &term) {
+              return mine.count(term.first);
+            }))
+              relevant.insert(row);
+      }
+      part.rows.insert(part.rows.end(), relevant.begin(), relevant.end());
+
+      part.equations = system.extract(part.rows, part.cols);
+      // They're solved side by side, so they have to share the budget.
+      part.solver = forced ? forced : choose(part.equations, budget / workers());
+      if(!part.solver)
+        return false;
+      subsystems.push_back(move(part));
+    }
+    system = equation_system();
+    diags() << "INFO: Solving " << subsystems.size() << " functions separately\n";
+  } else if(!forced && !memo && !streaming && focus_names.empty() && fits(reference->estimate(system), budget)) {
+    // The whole thing fits, so solve it in one go just as we always have.
+    // (Caching, streaming and focusing work on independent blocks, so that a change to one doesn't invalidate the
+    // others, the small ones needn't wait on the big ones, and the ones we don't care about can be left out.)
+    subsystem whole;
+    whole.rows.resize(system.rows.size());
+    iota(whole.rows.begin(), whole.rows.end(), 0);
+    whole.cols.resize(system.cols);
+    iota(whole.cols.begin(), whole.cols.end(), 0);
+    whole.equations = move(system);
+    whole.solver = reference;
+    subsystems.push_back(move(whole));
+  } else {
+    // Independent blocks can be solved one after another, so only the biggest one has to fit.
+    for(vector<int> &rows : system.partition()) {
+      subsystem part;
+      part.rows = move(rows);
+      part.equations = system.extract(part.rows, part.cols);
+      part.solver = forced ? forced : choose(part.equations, budget);
+      if(!part.solver)
+        return false;
+      subsystems.push_back(move(part));
+    }
+    system = equation_system();
+    diags() << "INFO: Solving " << subsystems.size() << " independent subsystems separately\n";
+  }
+  NumSubsystems += subsystems.size();
+
+  if(streaming)
+    // The sooner we get to something, the sooner we can report it.
+    stable_sort(subsystems.begin(), subsystems.end(), [](const subsystem &lhs, const subsystem &rhs) {
+      return lhs.equations.nonzeros() < rhs.equations.nonzeros();
+    });
+  for(subsystem &part : subsystems)
+    part.blamed = false;
+
+  for(int part = 0, parts = subsystems.size(); part < parts; ++part)
+    for(int row = 0, rows = subsystems[part].rows.size(); row < rows; ++row)
+      row_homes[subsystems[part].rows[row]] = {part, row};
+  return true;
+}
+
+const DimensionlessSolver *DimensionalAnalysis::choose(const equation_system &part, std::size_t budget) {
+  const DimensionlessSolver *small = DimensionlessSolver::get(small_solver);
+  if(fits(small->estimate(part), budget))
+    return small;
+
+  std::size_t cheapest = -1;
+  for(const char *name : fallbacks) {
+    const DimensionlessSolver *solver = DimensionlessSolver::get(name);
+    std::size_t need = solver->estimate(part);
+    if(fits(need, budget))
+      return solver;
+    cheapest = std::min(cheapest, need);
+  }
+
+  // Better to give up now than to be killed partway through.
+  string message;
+  raw_string_ostream stm(message);
+  stm << "ERROR: A subsystem of " << part.rows.size() << " equations in " << part.cols << " variables needs about "
+      << (cheapest >> 20) << " MiB to solve, which exceeds the -dimens-mem-budget of " << mem_budget << " MiB";
+  failure = stm.str();
+  diags() << failure << '\n';
+  return nullptr;
+}
+
+void DimensionalAnalysis::calcDimensionless() {
   dimensionless.clear();
+  presolved = presolve_sizes();
+  if(incremental) {
+    // We already know the answer.
+    for(const auto &each : forced_by)
+      dimensionless.push_back(each.first);
+    std::sort(dimensionless.begin(), dimensionless.end());
+    return;
+  }
 
-  double* A = new double[rows*cols];
-  double* sigmas = new double[rows+cols];
-  int work_sz = (rows+cols)*30;
-  double* work = new double[work_sz];
-  double* Vt = new double[cols*cols];
-  int ldvt = cols;
-  int info;
-
-  for (int i = 0; i < rows; ++i)
-    for (int j = 0; j < cols; ++j)
-      A[i+j*rows] = equations[i][j];
-
-  dgesvd_(&cN, &cA, &rows, &cols, A, &rows,
-          sigmas, NULL, &rows, Vt, &ldvt, work, &work_sz, &info);
-  assert(info == 0);
-
-  for (int i = min(cols, rows); i < cols; ++i)
-    sigmas[i] = 0;
-
-  const double eps = 1e-9;
-  for (int j = 0; j < cols; ++j) {
-    bool good = false;
-    for (int i = 0; i < cols; ++i) {
-      if (fabs(sigmas[i]) < eps && fabs(Vt[i+j*cols]) > eps) {
-        good = true;
+  if(!plan())
+    return;
+
+  vector<int> unsolved;
+  vector<char> cached(subsystems.size());
+  for(int index = 0, count = subsystems.size(); index < count; ++index) {
+    subsystem &part = subsystems[index];
+    if(memo) {
+      part.signature = signature(part);
+      if(const SolutionCache::solution *known = memo->find(part.signature)) {
+        part.dimensionless = known->dimensionless;
+        part.culprits = known->culprits;
+        part.blamed = known->blamed;
+        cached[index] = true;
+        ++NumReusedSubsystems;
+        if(!streaming)
+          continue;
       }
     }
-    if (!good) {
-      dimensionless.push_back(j);
+    unsolved.push_back(index);
+  }
+
+  // Findings go into the report itself, since the chatter is often thrown away (and always is on worker threads).
+  raw_ostream &report = early ? *early : outs();
+  std::mutex reporting;
+  vector<subsystem>::size_type reported = 0;
+
+  vector<presolve_sizes> tallies(unsolved.size());
+  vector<string> errors(unsolved.size());
+  auto deadline = blame_deadline();
+  parallel_for(unsolved.size(), [&](std::size_t each) {
+    subsystem &part = subsystems[unsolved[each]];
+    if(!cached[unsolved[each]] && !solve(part, nullptr, part.dimensionless, errors[each], &tallies[each]))
+      return;
+    if(!streaming)
+      return;
+
+    if(!part.blamed && !blame(part, deadline, errors[each]))
+      return;
+    std::lock_guard<std::mutex> lock(reporting);
+    print_component(report, part, ++reported);
+    report.flush();
+  });
+  // A solver that couldn't do its job at all leaves us with no answer, rather than the answer that nothing's forced.
+  for(const string &error : errors)
+    if(error.size()) {
+      failure = error;
+      diags() << failure << '\n';
+      return;
+    }
+  for(vector<int>::size_type each = 0, count = unsolved.size(); each < count; ++each) {
+    presolved.rows_before += tallies[each].rows_before;
+    presolved.cols_before += tallies[each].cols_before;
+    presolved.rows_after += tallies[each].rows_after;
+    presolved.cols_after += tallies[each].cols_after;
+    if(memo) {
+      const subsystem &part = subsystems[unsolved[each]];
+      SolutionCache::solution &known = memo->insert(part.signature);
+      known.dimensionless = part.dimensionless;
+      known.culprits = part.culprits;
+      known.blamed = part.blamed;
     }
   }
 
-  delete[] A;
-  delete[] sigmas;
-  delete[] work;
-  delete[] Vt;
+  for(const subsystem &part : subsystems)
+    for(int col : part.dimensionless)
+      dimensionless.push_back(part.cols[col]);
+  std::sort(dimensionless.begin(), dimensionless.end());
+  // Per-function copies of the same global might each have been forced.
+  dimensionless.erase(unique(dimensionless.begin(), dimensionless.end()), dimensionless.end());
+}
+
+bool DimensionalAnalysis::solve(const subsystem &part, const vector<bool> *omit, vector<int> &forced, string &error,
+    presolve_sizes *tally) const {
+  if(no_presolve)
+    return part.solver->solve(part.equations, omit, forced, error);
+  if(part.solver == DimensionlessSolver::get(small_solver)) {
+    // The fixed-size kernels take less time than presolve would, so this one counts as having been left as it was.
+    if(tally) {
+      tally->rows_before += part.equations.rows.size();
+      tally->cols_before += part.equations.cols;
+      tally->rows_after += part.equations.rows.size();
+      tally->cols_after += part.equations.cols;
+    }
+    return part.solver->solve(part.equations, omit, forced, error);
+  }
 
-  getBadEqns();
+  Presolve reduced(part.equations, omit);
+  if(tally) {
+    tally->rows_before += reduced.rows_before();
+    tally->cols_before += reduced.cols_before();
+    tally->rows_after += reduced.reduced().rows.size();
+    tally->cols_after += reduced.reduced().cols;
+    NumPresolvedRows += reduced.rows_before() - reduced.reduced().rows.size();
+  }
+  // What's left is often small enough for a fixed-size kernel, even if the whole subsystem wasn't.
+  const DimensionlessSolver *solver = part.solver, *small = DimensionlessSolver::get(small_solver);
+  if(solver_choice.empty() && small->estimate(reduced.reduced()) != (std::size_t) -1)
+    solver = small;
+  if(!solver->solve(reduced.reduced(), nullptr, forced, error))
+    return false;
+  forced = reduced.expand(forced);
+  return true;
 }
 
 void DimensionalAnalysis::getBadEqns() {
   int rows = equations.size();
-  int cols = equations[0].size();
-
-  char cN = 'N';
-  char cA = 'A';
-
-  double* A = new double[rows*cols];
-  double* sigmas = new double[rows+cols];
-  int work_sz = (rows+cols)*30;
-  double* work = new double[work_sz];
-  double* Vt = new double[cols*cols];
-  int ldvt = cols;
-  int info;
 
   bad_eqns.clear();
-  vector<int> new_dimensionless;
+  if (failure.size()) return;
+
+  auto line_of = [this](int row) {return locations[row] && bool(*locations[row]) ? locations[row]->getLine() : 0;};
+  if (incremental) {
+    // Whatever first forced each variable is the prime suspect, and there's no time to be saved by skipping any.
+    unordered_set<int> blamed;
+    for (int col : dimensionless)
+      if (!is_temporary(col) && blamed.insert(forced_by.lookup(col)).second)
+        bad_eqns.push_back(forced_by.lookup(col));
+    std::sort(bad_eqns.begin(), bad_eqns.end(), [&](int lhs, int rhs) {return line_of(lhs) < line_of(rhs);});
+    lines_checked = lines_total = 0;
+    return;
+  }
 
   map<int, vector<int> > line_to_rows;
   for (int i = 0; i < rows; ++i) {
@@ -281,59 +898,539 @@ void DimensionalAnalysis::getBadEqns() {
       line_to_rows[ locations[i]->getLine() ].push_back(i);
   }
 
-  for (auto pairs : line_to_rows) {
-    new_dimensionless.clear();
+  if (memo || intraprocedural || streaming) {
+    // Work out each subsystem's faulty lines on its own (if that hasn't happened already), so that the answer can be
+    // remembered along with it and, for separately analyzed functions, so that only their own lines are tried.
+    // (Any that ran out of time while streaming stay that way, since the time is up.)
+    vector<int> unblamed;
+    for (int index = 0, count = subsystems.size(); index < count; ++index)
+      if (!subsystems[index].blamed && subsystems[index].unchecked.empty())
+        unblamed.push_back(index);
+    vector<string> errors(unblamed.size());
+    auto deadline = blame_deadline();
+    parallel_for(unblamed.size(), [&](std::size_t each) {
+      blame(subsystems[unblamed[each]], deadline, errors[each]);
+    });
+    for (const string &error : errors)
+      if (error.size()) {
+        failure = error;
+        diags() << failure << '\n';
+        return;
+      }
+    if (memo)
+      for (int index : unblamed) {
+        SolutionCache::solution &known = *memo->find(subsystems[index].signature);
+        known.culprits = subsystems[index].culprits;
+        known.blamed = subsystems[index].blamed;
+      }
 
-    set<int> remove_rows(pairs.second.begin(), pairs.second.end());
-    int rem_num_rows = rows - pairs.second.size();
-    if (rem_num_rows == 0) continue;
+    std::set<int> bad_lines;
+    for (const subsystem &part : subsystems)
+      for (int local : part.culprits)
+        bad_lines.insert(line_of(part.rows[local]));
+    for (int line : bad_lines)
+      if ((int) line_to_rows.at(line).size() < rows)
+        bad_eqns.push_back(line_to_rows.at(line).front());
+
+    // A line only counts as checked once every subsystem it's part of has tried it.
+    std::set<unsigned> unchecked;
+    for (const subsystem &part : subsystems)
+      unchecked.insert(part.unchecked.begin(), part.unchecked.end());
+    lines_total = line_to_rows.size();
+    lines_checked = lines_total - unchecked.size();
+    if (lines_checked < lines_total)
+      diags() << "WARNING: Blame ran out of time after " << lines_checked << " of " << lines_total << " source lines\n";
+    return;
+  }
 
-    int counter_i = 0;
-    for (int i = 0; i < rows; ++i) {
-      if (!remove_rows.count(i)) {
-        for (int j = 0; j < cols; ++j)
-          A[counter_i+j*rem_num_rows] = equations[i][j];
-        ++counter_i;
+  // Whether dropping these equations frees any of the dimensionless source variables.
+  // If a solver fails along the way, that's our failure, and there's no point in trying anything else.
+  auto culpable = [&](const vector<int> &removed) {
+    // Dropping equations can only affect the subsystems that contain them.
+    map<int, vector<bool> > remove_rows;
+    for (int i : removed) {
+      if (row_homes[i].first < 0) continue;
+      vector<bool> &mask = remove_rows[row_homes[i].first];
+      mask.resize(subsystems[row_homes[i].first].equations.rows.size());
+      mask[row_homes[i].second] = true;
+    }
+
+    for (auto &each : remove_rows) {
+      const subsystem &part = subsystems[each.first];
+      vector<int> new_dimensionless;
+      if (!solve(part, &each.second, new_dimensionless, failure))
+        return false;
+      if (new_dimensionless == part.dimensionless) continue;
+
+      vector<int> eliminated;
+      set_difference(part.dimensionless.begin(), part.dimensionless.end(),
+                     new_dimensionless.begin(), new_dimensionless.end(),
+                     back_inserter(eliminated));
+      if (any_of(eliminated.begin(), eliminated.end(), [&](int col) {return !is_temporary(part.cols[col]);}))
+        return true;
+    }
+    return false;
+  };
+
+  auto deadline = blame_deadline();
+  auto out_of_time = [&] {return std::chrono::steady_clock::now() >= deadline;};
+  lines_checked = 0;
+  lines_total = line_to_rows.size();
+
+  if (hierarchical_blame) {
+    // Dropping more equations never forces more variables to zero, so if dropping every line a region touches frees
+    // nothing, neither does dropping any one of those lines, and the whole region can be ruled out at once.
+    vector<int> function_of(rows, -1);
+    for (int function = 0, count = function_rows.size(); function < count; ++function)
+      fill(function_of.begin() + function_rows[function].first, function_of.begin() + function_rows[function].second,
+           function);
+    map<int, map<const BasicBlock *, std::set<int> > > regions;
+    for (const auto &pairs : line_to_rows)
+      for (int i : pairs.second)
+        regions[function_of[i]][blocks[i]].insert(pairs.first);
+
+    std::set<int> decided, bad_lines;
+    auto rows_of = [&](const vector<int> &lines) {
+      vector<int> res;
+      for (int line : lines)
+        res.insert(res.end(), line_to_rows.at(line).begin(), line_to_rows.at(line).end());
+      return res;
+    };
+    // Narrow down the lines by halves, skipping any group that isn't at fault even with all of its lines dropped.
+    // (A group's being at fault says nothing about either half on its own, since it may take lines from both.)
+    std::function<void (const vector<int> &)> drill = [&](const vector<int> &lines) {
+      if (out_of_time() || failure.size())
+        return;
+      if (lines.size() == 1) {
+        decided.insert(lines.front());
+        const vector<int> &line_rows = line_to_rows.at(lines.front());
+        if ((int) line_rows.size() < rows && culpable(line_rows))
+          bad_lines.insert(lines.front());
+        return;
+      }
+      if (!culpable(rows_of(lines))) {
+        decided.insert(lines.begin(), lines.end());
+        return;
+      }
+      vector<int>::size_type half = lines.size() / 2;
+      drill(vector<int>(lines.begin(), lines.begin() + half));
+      drill(vector<int>(lines.begin() + half, lines.end()));
+    };
+
+    for (const auto &function : regions) {
+      std::set<int> touched;
+      for (const auto &block : function.second)
+        touched.insert(block.second.begin(), block.second.end());
+      vector<int> lines(touched.begin(), touched.end());
+      if (function.second.size() == 1) {
+        drill(lines);
+        continue;
+      }
+      if (out_of_time() || failure.size())
+        break;
+      if (!culpable(rows_of(lines))) {
+        decided.insert(lines.begin(), lines.end());
+        continue;
       }
+      for (const auto &block : function.second)
+        drill(vector<int>(block.second.begin(), block.second.end()));
     }
-    assert(counter_i == rem_num_rows);
 
-    dgesvd_(&cN, &cA, &rem_num_rows, &cols, A, &rem_num_rows,
-            sigmas, NULL, &rem_num_rows, Vt, &ldvt, work, &work_sz, &info);
-    assert(info == 0);
+    lines_checked = decided.size();
+    if (lines_checked < lines_total && failure.empty())
+      diags() << "WARNING: Blame ran out of time after " << lines_checked << " of " << lines_total << " source lines\n";
+    for (int line : bad_lines)
+      bad_eqns.push_back(line_to_rows.at(line).front());
+  } else {
+    // Try the lines touching the most dimensionless source variables first, in case we run out of time.
+    vector<pair<int, const vector<int> *> > suspects;
+    for (const auto &pairs : line_to_rows) {
+      unordered_set<int> touched;
+      for (int i : pairs.second)
+        for (const equation_term &term : equations[i])
+          if (!is_temporary(term.first) && binary_search(dimensionless.begin(), dimensionless.end(), (int) term.first))
+            touched.insert(term.first);
+      suspects.emplace_back(touched.size(), &pairs.second);
+    }
+    stable_sort(suspects.begin(), suspects.end(),
+                [](const pair<int, const vector<int> *> &lhs, const pair<int, const vector<int> *> &rhs) {
+                  return lhs.first > rhs.first;
+                });
+
+    for (const auto &suspect : suspects) {
+      if (failure.size())
+        break;
+      if (out_of_time()) {
+        diags() << "WARNING: Blame ran out of time after " << lines_checked << " of " << lines_total << " source lines\n";
+        break;
+      }
+      ++lines_checked;
 
-    for (int i = min(cols, rem_num_rows); i < cols; ++i)
-      sigmas[i] = 0;
+      const vector<int> &line_rows = *suspect.second;
+      int rem_num_rows = rows - line_rows.size();
+      if (rem_num_rows == 0) continue;
 
-    const double eps = 1e-9;
-    for (int j = 0; j < cols; ++j) {
-      bool good = false;
-      for (int i = 0; i < cols; ++i) {
-        if (fabs(sigmas[i]) < eps && fabs(Vt[i+j*cols]) > eps) {
-          good = true;
-        }
+      if (culpable(line_rows))
+        bad_eqns.push_back(line_rows.front()); // mark only one from the line as bad
+    }
+  }
+
+  if (failure.size()) {
+    diags() << failure << '\n';
+    bad_eqns.clear();
+    return;
+  }
+
+  // Report them in source order regardless.
+  std::sort(bad_eqns.begin(), bad_eqns.end(), [&](int lhs, int rhs) {return line_of(lhs) < line_of(rhs);});
+}
+
+string DimensionalAnalysis::signature(const subsystem &part) const {
+  // Everything its solution and blame depend on: the coefficients, which columns are temporaries, and which rows share
+  // a line (though not which line, so that edits elsewhere in the file don't throw off the line numbers).
+  string res;
+  raw_string_ostream stm(res);
+  for (int col : part.cols)
+    stm << (is_temporary(col) ? 't' : 's');
+  unordered_map<unsigned, unsigned> lines;
+  for (int row = 0, count = part.rows.size(); row < count; ++row) {
+    const DebugLoc *loc = locations[part.rows[row]];
+    stm << '|';
+    if (loc && *loc)
+      stm << lines.emplace(loc->getLine(), lines.size()).first->second;
+    for (const auto &term : part.equations.rows[row])
+      stm << ' ' << term.first << '*' << term.second;
+  }
+  return stm.str();
+}
+
+bool DimensionalAnalysis::blame(subsystem &part, std::chrono::steady_clock::time_point deadline, string &error) const {
+  map<unsigned, vector<int> > line_to_rows;
+  for (int row = 0, count = part.rows.size(); row < count; ++row) {
+    const DebugLoc *loc = locations[part.rows[row]];
+    if (loc && *loc)
+      line_to_rows[loc->getLine()].push_back(row);
+  }
+
+  // As in getBadEqns, try the lines touching the most dimensionless source variables first, in case we run out of time.
+  vector<pair<int, unsigned> > suspects;
+  for (const auto &pairs : line_to_rows) {
+    unordered_set<int> touched;
+    for (int row : pairs.second)
+      for (const auto &term : part.equations.rows[row])
+        if (!is_temporary(part.cols[term.first]) &&
+            binary_search(part.dimensionless.begin(), part.dimensionless.end(), (int) term.first))
+          touched.insert(term.first);
+    suspects.emplace_back(touched.size(), pairs.first);
+  }
+  stable_sort(suspects.begin(), suspects.end(), [](const pair<int, unsigned> &lhs, const pair<int, unsigned> &rhs) {
+    return lhs.first > rhs.first;
+  });
+
+  part.culprits.clear();
+  part.unchecked.clear();
+  for (const auto &suspect : suspects) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      part.unchecked.push_back(suspect.second);
+      continue;
+    }
+
+    const vector<int> &line_rows = line_to_rows.at(suspect.second);
+    vector<bool> mask(part.rows.size());
+    for (int row : line_rows)
+      mask[row] = true;
+    vector<int> new_dimensionless;
+    if (!solve(part, &mask, new_dimensionless, error))
+      return false;
+
+    vector<int> eliminated;
+    set_difference(part.dimensionless.begin(), part.dimensionless.end(),
+                   new_dimensionless.begin(), new_dimensionless.end(),
+                   back_inserter(eliminated));
+    if (any_of(eliminated.begin(), eliminated.end(), [&](int col) {return !is_temporary(part.cols[col]);}))
+      part.culprits.push_back(line_rows.front());
+  }
+
+  // Back into source order.
+  std::sort(part.culprits.begin(), part.culprits.end(), [&](int lhs, int rhs) {
+    return locations[part.rows[lhs]]->getLine() < locations[part.rows[rhs]]->getLine();
+  });
+  part.blamed = part.unchecked.empty();
+  return true;
+}
+
+void DimensionalAnalysis::analyze_scc(const vector<Function *> &members) {
+  current_scc.clear();
+  current_scc.insert(members.begin(), members.end());
+
+  vector<sparse_equation>::size_type first_row = equations.size();
+  string key;
+  vector<resolution> resolutions;
+  {
+    TimeRegion timing(TimePassesIsEnabled ? &traversal_timer : nullptr);
+
+    // If we've already seen a function of this shape, substitute our values into its equations instead.
+    // (Alias classes span functions, so the same shape no longer means the same equations.)
+    if(!no_dedup && !points_to && members.size() == 1 && (key = shape(*members.front())).size()) {
+      auto known = templates.find(key);
+      if(known == templates.end())
+        recording = &resolutions;
+      else if(transplant(known->second, *members.front())) {
+        current_scc.clear();
+        return;
       }
-      if (!good) {
-        new_dimensionless.push_back(j);
+    }
+
+    for(Function *function : members) {
+      vector<sparse_equation>::size_type rows_before = equations.size();
+      index_type cols_before = variables.size();
+      for(BasicBlock &block : function->getBasicBlockList()) {
+        current_block = &block;
+        for(Instruction &inst : block.getInstList())
+          instruction_opdecode(inst);
+      }
+      current_block = nullptr;
+      function_rows.emplace_back(rows_before, equations.size());
+
+      if(print_function_costs) {
+        function_cost cost = {function, equations.size() - rows_before, variables.size() - cols_before, 0};
+        for(auto row = equations.begin() + rows_before, end = equations.end(); row != end; ++row)
+          cost.nonzeros += row->size();
+        costs.push_back(cost);
       }
     }
 
-    if (new_dimensionless != dimensionless) { // maybe size difference at least 2 ?
-      //      TRACE(rem_row _ new_dimensionless.size() _ dimensionless.size());
-      vector<int> eliminated;
-      set_difference(dimensionless.begin(), dimensionless.end(),
-                     new_dimensionless.begin(), new_dimensionless.end(),
-                     back_inserter(eliminated));
-      if (count_if(eliminated.begin(), eliminated.end(), not1(is_temporary))) {
-        bad_eqns.push_back(pairs.second.front()); // mark only one from the line as bad
+    if(recording) {
+      recording = nullptr;
+      templates.emplace(key, template_body{members.front(), first_row, equations.size(), move(resolutions)});
+    }
+  }
+
+  if(intraprocedural) {
+    // Calls aren't followed, so there's no call for summaries; just note that these functions are done.
+    for(Function *function : members)
+      summaries[function];
+    current_scc.clear();
+    return;
+  }
+
+  // Only now that the whole SCC has been related can we project out each member's internals.
+  // (Their rows stay in the system all the same, since the variables they mention can be dimensionless and their lines
+  // are as much to blame as the callers'; it's the call sites that the summaries keep small.)
+  TimeRegion timing(TimePassesIsEnabled ? &summary_timer : nullptr);
+  for(Function *function : members)
+    summarize(*function, first_row);
+  current_scc.clear();
+}
+
+void DimensionalAnalysis::summarize(Function &function, vector<sparse_equation>::size_type first_row) {
+  vector<EchelonForm::row> &summary = summaries[&function];
+  summary.clear();
+
+  // Interface columns, by slot: the return value followed by each formal parameter.
+  vector<index_type> interface;
+  interface.push_back(function.getReturnType()->isVoidTy() ? -1 : lookup(function));
+  for(Argument &formal : function.getArgumentList())
+    interface.push_back(lookup(formal));
+
+  // Number the internal columns before the interface ones so that elimination gets rid of them first.
+  unordered_map<index_type, EchelonForm::column> local;
+  for(auto row = equations.begin() + first_row, end = equations.end(); row != end; ++row)
+    for(const equation_term &term : *row)
+      if(!local.count(term.first) && find(interface.begin(), interface.end(), term.first) == interface.end())
+        local.emplace(term.first, local.size());
+  EchelonForm::column first_interface = local.size();
+  for(index_type slot = 0, sz = interface.size(); slot < sz; ++slot)
+    if(interface[slot] != (index_type) -1) {
+      auto known = local.find(interface[slot]);
+      if(known == local.end())
+        local.emplace(interface[slot], first_interface + slot);
+      else
+        // Two slots share a column (e.g. parameters bound to the same source variable), so they're trivially equal.
+        summary.push_back({
+          EchelonForm::row::value_type(known->second - first_interface, 1),
+          EchelonForm::row::value_type(slot, -1),
+        });
+    }
+
+  EchelonForm form;
+  for(auto row = equations.begin() + first_row, end = equations.end(); row != end; ++row) {
+    EchelonForm::row eqn;
+    for(const equation_term &term : *row)
+      eqn.emplace_back(local.at(term.first), term.second);
+    std::sort(eqn.begin(), eqn.end());
+    form.insert(move(eqn));
+  }
+
+  // Echelon rows led by an interface column mention no internal ones, and they span all implied interface relations.
+  for(auto pivot = form.rows().lower_bound(first_interface), end = form.rows().end(); pivot != end; ++pivot) {
+    EchelonForm::row relation = pivot->second;
+    for(auto &term : relation)
+      term.first -= first_interface;
+    summary.push_back(move(relation));
+  }
+
+  if(summary.size())
+    diags() << "Summarized " << function.getName() << " with " << summary.size() << " interface relations\n";
+}
+
+string DimensionalAnalysis::shape(const Function &function) const {
+  // Everything that determines the function's equations, except the identities of the values involved.
+  // This is empty for recursive functions, which don't have summaries of their own callees to compare.
+  unordered_map<const Value *, unsigned> ordinals;
+  for(const BasicBlock &block : function) {
+    ordinals.emplace(&block, ordinals.size());
+    for(const Instruction &inst : block)
+      ordinals.emplace(&inst, ordinals.size());
+  }
+
+  string res;
+  raw_string_ostream stm(res);
+  stm << (function.getReturnType()->isVoidTy() ? 'v' : 'r') << function.arg_size();
+  for(const BasicBlock &block : function) {
+    stm << '{';
+    for(const Instruction &inst : block) {
+      stm << ' ' << role(inst.getOpcode());
+      if(const LoadInst *load = dyn_cast<LoadInst>(&inst))
+        stm << (load->isVolatile() ? "v" : "");
+      else if(const StoreInst *store = dyn_cast<StoreInst>(&inst))
+        stm << (store->isVolatile() ? "v" : "");
+      else if(const CastInst *cast = dyn_cast<CastInst>(&inst)) {
+        // Casts relate values, memory or nothing depending on what they're between.
+        if(cast->getSrcTy()->getScalarType()->isPointerTy() || cast->getDestTy()->getScalarType()->isPointerTy())
+          stm << (widened(*cast) ? "w" : "p");
+      } else if(const IntrinsicInst *intrinsic = dyn_cast<IntrinsicInst>(&inst))
+        stm << 'i' << intrinsic->getIntrinsicID();
+      if(const GEPOperator *gep = dyn_cast<GEPOperator>(&inst))
+        if(PointerType *point = dyn_cast<PointerType>(gep->getPointerOperandType()))
+          if(isa<StructType>(point->getElementType()))
+            // We'll index a struct field rather than the pointer itself.
+            stm << 's';
+
+      stm << '(';
+      for(const Use &op : inst.operands()) {
+        const Value *val = op;
+        if(is_const(val))
+          stm << 'k';
+        else if(const Argument *formal = dyn_cast<Argument>(val))
+          stm << 'a' << formal->getArgNo();
+        else if(ordinals.count(val))
+          stm << '%' << ordinals.at(val);
+        else if(const Function *callee = dyn_cast<Function>(val)) {
+          if(current_scc.count(callee))
+            return "";
+          // Callees need only agree on what we'd instantiate at the call.
+          stm << 'f';
+          auto summary = summaries.find(callee);
+          if(summary != summaries.end())
+            for(const EchelonForm::row &relation : summary->second) {
+              stm << '[';
+              for(const auto &term : relation)
+                stm << term.first << ':' << term.second << ' ';
+              stm << ']';
+            }
+        } else if(isa<MetadataAsValue>(val))
+          stm << 'm';
+        else
+          stm << 'g';
+        stm << ',';
+      }
+      stm << ')';
+    }
+    stm << '}';
+  }
+  return stm.str();
+}
+
+bool DimensionalAnalysis::transplant(const template_body &body, Function &function) {
+  const Function &model = *body.function;
+
+  // Pair up each of the model's values with the one in the same position here.
+  unordered_map<unsigned long, Value *> counterparts;
+  unordered_map<const DebugLoc *, const DebugLoc *> spots;
+  unordered_map<const BasicBlock *, const BasicBlock *> peer_blocks;
+  auto pair_up = [&counterparts](const Value &from, Value &to) {
+    return counterparts.emplace((unsigned long) &from, &to).first->second == &to;
+  };
+  bool ok = pair_up(model, function);
+  Function::arg_iterator other_formal = function.arg_begin();
+  for(auto formal = model.arg_begin(), end = model.arg_end(); ok && formal != end; ++formal, ++other_formal)
+    ok = pair_up(*formal, *other_formal);
+  Function::iterator other_block = function.begin();
+  for(auto block = model.begin(), end = model.end(); ok && block != end; ++block, ++other_block) {
+    peer_blocks.emplace(&*block, &*other_block);
+    BasicBlock::iterator other = other_block->begin();
+    for(auto inst = block->begin(), block_end = block->end(); ok && inst != block_end; ++inst, ++other) {
+      ok = pair_up(*inst, *other);
+      spots.emplace(&inst->getDebugLoc(), &other->getDebugLoc());
+      for(unsigned op = 0, ops = inst->getNumOperands(); ok && op < ops; ++op) {
+        const Value *from = inst->getOperand(op);
+        if(!is_const(from) && !isa<BasicBlock>(from) && !isa<MetadataAsValue>(from))
+          ok = pair_up(*from, *other->getOperand(op));
       }
     }
   }
 
-  delete[] A;
-  delete[] sigmas;
-  delete[] work;
-  delete[] Vt;
+  // Repeat the model's lookups on our values, checking that its columns correspond one-to-one with ours.
+  index_type cols_before = variables.size();
+  unordered_map<index_type, index_type> columns;
+  unordered_set<index_type> taken;
+  for(auto each = body.resolutions.begin(), end = body.resolutions.end(); ok && each != end; ++each) {
+    auto other = counterparts.find(each->var);
+    if(other == counterparts.end()) {
+      ok = false;
+      break;
+    }
+
+    index_type col;
+    switch(each->how) {
+      case resolution::VALUE:
+        col = index(*other->second);
+        break;
+      case resolution::MEMORY:
+        col = index_mem(*other->second);
+        break;
+      case resolution::POINTER:
+        col = insert_mem(*other->second);
+        break;
+    }
+    if(col == (index_type) -1 || each->col == (index_type) -1)
+      ok = col == each->col;
+    else {
+      auto known = columns.emplace(each->col, col);
+      ok = known.first->second == col && (!known.second || taken.insert(col).second);
+    }
+  }
+  if(!ok) {
+    // Whatever we've looked up so far is exactly what a full analysis would look up first, so nothing's amiss.
+    diags() << "Couldn't carry over the equations of " << model.getName() << " to " << function.getName() << '\n';
+    return false;
+  }
+
+  diags() << "Carrying over the equations of " << model.getName() << " to " << function.getName() << '\n';
+  vector<sparse_equation>::size_type rows_before = equations.size();
+  for(auto row = body.first_row; row < body.last_row; ++row) {
+    equation_builder equation;
+    for(const equation_term &term : equations[row])
+      elem(equation, columns.at(term.first)) += term.second;
+    // Blame our own source locations, not the model's.
+    auto spot = spots.find(locations[row]);
+    auto peer = peer_blocks.find(blocks[row]);
+    current_block = peer == peer_blocks.end() ? nullptr : peer->second;
+    equate(move(equation), spot == spots.end() ? nullptr : spot->second);
+  }
+  current_block = nullptr;
+  function_rows.emplace_back(rows_before, equations.size());
+  summaries[&function] = summaries.at(&model);
+  ++NumTransplants;
+
+  if(print_function_costs) {
+    function_cost cost = {&function, body.last_row - body.first_row, variables.size() - cols_before, 0};
+    for(auto row = equations.end() - cost.rows, end = equations.end(); row != end; ++row)
+      cost.nonzeros += row->size();
+    costs.push_back(cost);
+  }
+  return true;
 }
 
 void DimensionalAnalysis::instruction_opdecode(Instruction &inst) {
@@ -344,7 +1441,7 @@ void DimensionalAnalysis::instruction_opdecode(Instruction &inst) {
     case Instruction::Sub:
     case Instruction::FSub:
     case Instruction::PHI:
-      errs() << "Processing instruction: " << inst << '\n';
+      diags() << "Processing instruction: " << inst << '\n';
       for(Use &op : inst.operands())
         instruction_setequal(inst, *op, &inst.getDebugLoc());
       break;
@@ -355,24 +1452,28 @@ void DimensionalAnalysis::instruction_opdecode(Instruction &inst) {
     case Instruction::UDiv:
     case Instruction::SDiv:
     case Instruction::FDiv:
-      errs() << "Processing instruction: " << inst << '\n';
+      diags() << "Processing instruction: " << inst << '\n';
       instruction_setadditive(inst, multiplier, &inst.getDebugLoc());
       break;
 
     case Instruction::Load:
-      errs() << "Processing instruction: " << inst << '\n';
+      diags() << "Processing instruction: " << inst << '\n';
+      if(forwarded(inst)) {
+        diags() << "\tforwarded from the stack slot\n";
+        break;
+      }
       insert_mem(*inst.getOperand(0));
       instruction_setequal(inst, *inst.getOperand(0), &inst.getDebugLoc(), &DimensionalAnalysis::index_mem);
       break;
 
     case Instruction::Store:
-      errs() << "Processing instruction: " << inst << '\n';
+      diags() << "Processing instruction: " << inst << '\n';
       insert_mem(*inst.getOperand(1));
       instruction_setequal(*inst.getOperand(1), *inst.getOperand(0), &inst.getDebugLoc(), &DimensionalAnalysis::index_mem);
       break;
 
     case Instruction::GetElementPtr: {
-      errs() << "Processing instruction: " << inst << '\n';
+      diags() << "Processing instruction: " << inst << '\n';
       if(insert_mem(inst) == -1) {
         //assert(false);
         // TODO: think about this case, will it break something else?
@@ -382,9 +1483,184 @@ void DimensionalAnalysis::instruction_opdecode(Instruction &inst) {
 
     case Instruction::ICmp:
     case Instruction::FCmp:
-      errs() << "Processing instruction: " << inst << '\n';
+      diags() << "Processing instruction: " << inst << '\n';
       instruction_setequal(*inst.getOperand(0), *inst.getOperand(1), &inst.getDebugLoc());
       break;
+
+    case Instruction::Select:
+    case Instruction::InsertElement:
+    case Instruction::ShuffleVector: {
+      // Either data operand could end up in the result. A select's condition comes before them, while an insertelement's
+      // index and a shufflevector's mask come after.
+      diags() << "Processing instruction: " << inst << '\n';
+      unsigned first = isa<SelectInst>(inst);
+      for(unsigned op = first; op < first + 2; ++op)
+        instruction_setequal(inst, *inst.getOperand(op), &inst.getDebugLoc());
+      break;
+    }
+
+    case Instruction::ExtractElement:
+      // All lanes of a vector share a single column.
+      diags() << "Processing instruction: " << inst << '\n';
+      instruction_setequal(inst, *inst.getOperand(0), &inst.getDebugLoc());
+      break;
+
+    case Instruction::Trunc:
+    case Instruction::ZExt:
+    case Instruction::SExt:
+    case Instruction::FPTrunc:
+    case Instruction::FPExt:
+    case Instruction::FPToUI:
+    case Instruction::FPToSI:
+    case Instruction::UIToFP:
+    case Instruction::SIToFP:
+    case Instruction::BitCast:
+      if(Value *mem = widened(inst)) {
+        // Reinterpreting scalars as vectors of them (as the vectorizers do) leaves the memory's dimensions alone.
+        diags() << "Processing instruction: " << inst << '\n';
+        insert_mem(inst);
+        insert_mem(*mem);
+        instruction_setequal(inst, *mem, &inst.getDebugLoc(), &DimensionalAnalysis::index_mem);
+      } else if(!inst.getType()->getScalarType()->isPointerTy() &&
+          !inst.getOperand(0)->getType()->getScalarType()->isPointerTy()) {
+        // A change of representation doesn't change what's being represented.
+        diags() << "Processing instruction: " << inst << '\n';
+        instruction_setequal(inst, *inst.getOperand(0), &inst.getDebugLoc());
+      }
+      break;
+
+    case Instruction::Ret:
+      if(Value *result = cast<ReturnInst>(inst).getReturnValue()) {
+        diags() << "Processing instruction: " << inst << '\n';
+        // The function itself stands for its return value.
+        instruction_setequal(*inst.getParent()->getParent(), *result, &inst.getDebugLoc());
+      }
+      break;
+
+    case Instruction::Call:
+    case Instruction::Invoke:
+      if(IntrinsicInst *intrinsic = dyn_cast<IntrinsicInst>(&inst))
+        instruction_intrinsic(*intrinsic);
+      else
+        instruction_call(CallSite(&inst));
+      break;
+  }
+}
+
+void DimensionalAnalysis::instruction_intrinsic(IntrinsicInst &inst) {
+  const DebugLoc *loc = &inst.getDebugLoc();
+  switch(inst.getIntrinsicID()) {
+    case Intrinsic::minnum:
+    case Intrinsic::maxnum:
+      // Either operand could be the result.
+      diags() << "Processing instruction: " << inst << '\n';
+      instruction_setequal(inst, *inst.getArgOperand(0), loc);
+      instruction_setequal(inst, *inst.getArgOperand(1), loc);
+      break;
+
+    case Intrinsic::fabs:
+    case Intrinsic::copysign:
+    case Intrinsic::floor:
+    case Intrinsic::ceil:
+    case Intrinsic::trunc:
+    case Intrinsic::rint:
+    case Intrinsic::nearbyint:
+    case Intrinsic::round:
+      // Only the first operand's magnitude goes into the result.
+      diags() << "Processing instruction: " << inst << '\n';
+      instruction_setequal(inst, *inst.getArgOperand(0), loc);
+      break;
+
+    case Intrinsic::sqrt: {
+      Value &radicand = *inst.getArgOperand(0);
+      if(is_const(&radicand))
+        break;
+      diags() << "Processing instruction: " << inst << '\n';
+      index_type root = index(inst), square = index(radicand);
+      diags() << "\t2 deg(" << variables.name(root) << ") = deg(" << variables.name(square) << ")\n";
+      equation_builder equation;
+      elem(equation, root) += 2;
+      elem(equation, square) += -1;
+      equate(move(equation), loc);
+      break;
+    }
+
+    case Intrinsic::fma:
+    case Intrinsic::fmuladd: {
+      // The product's dimensions are the sum of the factors', and it's then added to the third operand.
+      diags() << "Processing instruction: " << inst << '\n';
+      instruction_setequal(inst, *inst.getArgOperand(2), loc);
+
+      equation_builder equation;
+      index_type product = index(inst);
+      elem(equation, product) += 1;
+      bool ran = false;
+      for(unsigned factor = 0; factor < 2; ++factor)
+        if(!is_const(inst.getArgOperand(factor))) {
+          index_type term = index(*inst.getArgOperand(factor));
+          diags() << (ran ? " + " : "\tdeg(" + variables.name(product) + ") = ") << "deg(" << variables.name(term) << ')';
+          elem(equation, term) += -1;
+          ran = true;
+        }
+      if(ran) {
+        diags() << '\n';
+        equate(move(equation), loc);
+      }
+      break;
+    }
+  }
+}
+
+Value *DimensionalAnalysis::widened(const Instruction &cast) {
+  PointerType *from = dyn_cast<PointerType>(cast.getOperand(0)->getType());
+  PointerType *to = dyn_cast<PointerType>(cast.getType());
+  if(!from || !to)
+    return nullptr;
+  VectorType *lanes = dyn_cast<VectorType>(to->getElementType());
+  return lanes && lanes->getElementType() == from->getElementType() ? cast.getOperand(0) : nullptr;
+}
+
+void DimensionalAnalysis::instruction_call(CallSite call) {
+  Function *callee = call.getCalledFunction();
+  if(!callee || callee->isDeclaration())
+    // Indirect call or external code (including intrinsics), about which we know nothing.
+    return;
+  if(intraprocedural)
+    // Each function stands alone.
+    return;
+
+  Instruction &inst = *call.getInstruction();
+  const DebugLoc *loc = &inst.getDebugLoc();
+  diags() << "Processing instruction: " << inst << '\n';
+
+  if(current_scc.count(callee)) {
+    // Recursion: there's no summary yet, so bind the actuals directly to the formals.
+    Function::arg_iterator formal = callee->arg_begin(), formal_end = callee->arg_end();
+    for(auto actual = call.arg_begin(), end = call.arg_end(); actual != end && formal != formal_end; ++actual, ++formal)
+      instruction_setequal(*formal, **actual, loc);
+    if(!inst.getType()->isVoidTy())
+      instruction_setequal(inst, *callee, loc);
+    return;
+  }
+
+  // Instantiate the callee's summary over this call's actual arguments and result.
+  for(const EchelonForm::row &relation : summaries[callee]) {
+    equation_builder equation;
+    bool wildcard = false;
+    for(const auto &term : relation) {
+      Value *actual = term.first ? (term.first <= call.arg_size() ? call.getArgument(term.first - 1) : nullptr) : &inst;
+      if(!actual || is_const(actual)) {
+        // Constants take on whatever dimensions they need to, so this relation tells us nothing here.
+        wildcard = true;
+        break;
+      }
+      elem(equation, index(*actual)) += term.second;
+    }
+
+    if(!wildcard && any_of(equation.begin(), equation.end(), [](const equation_term &term) {return term.second;})) {
+      diags() << "\tinstantiated summary of " << callee->getName() << '\n';
+      equate(move(equation), loc);
+    }
   }
 }
 
@@ -402,8 +1678,8 @@ void DimensionalAnalysis::instruction_setequal(const dimens_var &dest, const dim
   if(d == s)
     return;
 
-  errs() << "\tdeg(" << (const string &) variables[d] << ") = deg(" << (const string &) variables[s] << ")\n";
-  vector<int> equation;
+  diags() << "\tdeg(" << variables.name(d) << ") = deg(" << variables.name(s) << ")\n";
+  equation_builder equation;
   elem(equation, d) += 1;
   elem(equation, s) += -1;
   equate(move(equation), loc);
@@ -414,7 +1690,7 @@ void DimensionalAnalysis::instruction_setadditive(llvm::Instruction &line, int m
     return;
 
   bool ran = false;
-  vector<int> equation;
+  equation_builder equation;
   index_type lhs = index(line);
   elem(equation, lhs) += 1;
   for(Use &op : line.operands())
@@ -422,49 +1698,69 @@ void DimensionalAnalysis::instruction_setadditive(llvm::Instruction &line, int m
       index_type term = index(*op);
       if(!ran) {
         // First term...
-        errs() << "\tdeg(" << (const string &) variables[lhs] << ") = deg(" << (const string &) variables[term] << ')';
+        diags() << "\tdeg(" << variables.name(lhs) << ") = deg(" << variables.name(term) << ')';
         // is always positive.
         elem(equation, term) += -1;
         ran = true;
       } else {
         // Subsequent term
-        errs() << (multiplier < 0 ? " + " : " - ") << "deg(" << (const string &) variables[term] << ')';
+        diags() << (multiplier < 0 ? " + " : " - ") << "deg(" << variables.name(term) << ')';
         elem(equation, term) += multiplier;
       }
     }
 
   if(ran) {
-    errs() << '\n';
+    diags() << '\n';
     equate(move(equation), loc);
   }
 }
 
-int &DimensionalAnalysis::elem(vector<int> &arr, DimensionalAnalysis::index_type idx) {
+int &DimensionalAnalysis::elem(equation_builder &eqn, DimensionalAnalysis::index_type idx) {
   assert(idx != -1);
 
-  if(idx >= arr.size())
-    arr.resize(idx + 1);
-  return arr[idx];
+  // So few terms are quicker to scan than to sort or hash.
+  for(equation_term &term : eqn)
+    if(term.first == idx)
+      return term.second;
+  eqn.emplace_back(idx, 0);
+  return eqn.back().second;
 }
 
 DimensionalAnalysis::index_type DimensionalAnalysis::index_mem(const dimens_var &var) {
-  return indirections.count(var) ? indirections[var] : index(var);
+  ++nesting;
+  index_type res;
+  if(indirections.count(var))
+    res = indirections[var];
+  else if(Value *representative = var.value() ? aliases.representative(*var.value()) : nullptr)
+    res = index_alias(*representative);
+  else
+    res = index(var);
+  --nesting;
+  record(resolution::MEMORY, var, res);
+  return res;
 }
 
 DimensionalAnalysis::index_type DimensionalAnalysis::insert_mem(Value &gep) {
+  ++nesting;
+  index_type res = canonicalize_mem(gep);
+  --nesting;
+  record(resolution::POINTER, (unsigned long) &gep, res);
+  return res;
+}
+
+DimensionalAnalysis::index_type DimensionalAnalysis::canonicalize_mem(Value &gep) {
   dimens_var noncanon = gep;
   index_type canonical = -1;
 
-  if(GEPOperator *gep_oper = dyn_cast<GEPOperator>(&gep))
+  if(Value *representative = aliases.representative(gep))
+    // The whole alias class shares one location.
+    canonical = index_alias(*representative);
+  else if(GEPOperator *gep_oper = dyn_cast<GEPOperator>(&gep))
     if(PointerType *point = dyn_cast<PointerType>(gep_oper->getPointerOperandType())) {
-      if(StructType *struct_ty = dyn_cast<StructType>(point->getElementType())) {
-        DataLayout layout(module);
-        IntegerType *point_ty = layout.getIntPtrType(module->getContext(), point->getAddressSpace());
-        APInt offset(point_ty->getBitWidth(), 0);
-        if(!gep_oper->accumulateConstantOffset(layout, offset))
+      if(isa<StructType>(point->getElementType())) {
+        canonical = index_field(*gep_oper);
+        if(canonical == -1)
           return -1; // not a constant
-
-        canonical = index_mem(dimens_var(*struct_ty, offset));
       } else
         canonical = index_mem(*gep_oper->getOperand(0));
     }
@@ -472,12 +1768,38 @@ DimensionalAnalysis::index_type DimensionalAnalysis::insert_mem(Value &gep) {
     return -1;
 
   if(!indirections.count(noncanon))
-    indirections.emplace(noncanon, canonical);
-  errs() << "\tindirect[" << (const string &) noncanon << "] = " << (const string &) variables[canonical] << '\n';
+    indirections.insert(std::make_pair((unsigned long) noncanon, canonical));
+  diags() << "\tindirect[" << noncanon.str() << "] = " << variables.name(canonical) << '\n';
   return canonical;
 }
 
+DimensionalAnalysis::index_type DimensionalAnalysis::index_field(GEPOperator &gep) {
+  PointerType *point = cast<PointerType>(gep.getPointerOperandType());
+  DataLayout layout(module);
+  IntegerType *point_ty = layout.getIntPtrType(module->getContext(), point->getAddressSpace());
+  APInt offset(point_ty->getBitWidth(), 0);
+  if(!gep.accumulateConstantOffset(layout, offset))
+    return -1;
+  return index_mem(dimens_var(*cast<StructType>(point->getElementType()), offset));
+}
+
+DimensionalAnalysis::index_type DimensionalAnalysis::index_alias(Value &representative) {
+  auto known = alias_columns.find(&representative);
+  if(known != alias_columns.end())
+    return known->second;
+
+  // If the class includes a struct field, that's the location it stands for; otherwise, any member will do.
+  index_type res = -1;
+  if(GEPOperator *field = aliases.field(representative))
+    res = index_field(*field);
+  if(res == (index_type) -1)
+    res = index(representative);
+  alias_columns.insert(std::make_pair(&representative, res));
+  return res;
+}
+
 DimensionalAnalysis::index_type DimensionalAnalysis::index(const dimens_var &var) {
+  ++nesting;
   index_type res;
   if(indices.count(var))
     // There's already an entry for this program variable, so just use it.
@@ -485,29 +1807,92 @@ DimensionalAnalysis::index_type DimensionalAnalysis::index(const dimens_var &var
   else if(DIVariable *source_var = var)
     // This program variable is a register with an associated source variable, so use that.
     res = index(*source_var);
+  else if(AllocaInst *slot = var.value() ? forwarded(*var.value()) : nullptr)
+    // This program variable was loaded from a stack slot that mem2reg would have eliminated, so use its contents.
+    res = index(*slot);
   else
     // This program variable is a new temporary we haven't seen before, so add an entry.
     res = insert(var);
+  --nesting;
 
   assert(res < variables.size());
+  record(resolution::VALUE, var, res);
   return res;
 }
 
+DimensionalAnalysis::index_type DimensionalAnalysis::lookup(const dimens_var &var) const {
+  if(indices.count(var))
+    return indices.lookup(var);
+  if(DIVariable *source_var = var)
+    return lookup(*source_var);
+  return -1;
+}
+
+AllocaInst *DimensionalAnalysis::forwarded(Value &val) {
+  // The slot's contents are equated with every value stored there, as mem2reg and TraceVariablesNg would have done for
+  // the registers carrying a source variable, so a load might as well stand for the slot itself rather than adding a
+  // column and equation of its own.
+  LoadInst *load = dyn_cast<LoadInst>(&val);
+  if(no_forwarding || !load)
+    return nullptr;
+  AllocaInst *slot = dyn_cast<AllocaInst>(load->getPointerOperand());
+  if(!slot)
+    return nullptr;
+
+  auto known = promotable.find(slot);
+  if(known == promotable.end())
+    known = promotable.insert(std::make_pair(slot, isAllocaPromotable(slot))).first;
+  return known->second ? slot : nullptr;
+}
+
 DimensionalAnalysis::index_type DimensionalAnalysis::insert(const dimens_var &var) {
   assert(!indices.count(var));
 
+  // Make sure no temporaries are erroneously added for registers already associated with a source variable.
+  assert(!(DIVariable *) var);
+
   index_type ind = variables.size();
-  variables.push_back(var);
-  indices.emplace(var, indices.size());
+  // Struct fields are shared between all instances, so they count as source variables.
+  variables.push_back(var, ind >= first_temporary && var.which() != dimens_var::FIELD);
+  indices.insert(std::make_pair((unsigned long) var, (index_type) indices.size()));
   assert(variables.size() == indices.size());
 
   return ind;
 }
 
-void DimensionalAnalysis::equate(vector<int> &&eqn, const DebugLoc *loc) {
-  equations.push_back(move(eqn));
+void DimensionalAnalysis::record(resolution::kind how, unsigned long var, index_type col) {
+  if(recording && !nesting)
+    recording->push_back({how, var, col});
+}
+
+void DimensionalAnalysis::equate(equation_builder &&eqn, const DebugLoc *loc) {
+  eqn.erase(remove_if(eqn.begin(), eqn.end(), [](const equation_term &term) {return !term.second;}), eqn.end());
+  std::sort(eqn.begin(), eqn.end());
+
+  if(incremental) {
+    EchelonForm::row sparse(eqn.begin(), eqn.end());
+
+    // Any variable this forces to zero has now been shown to be dimensionless, so say so right away.
+    for(EchelonForm::column col : progress.insert(move(sparse))) {
+      forced_by.insert(std::make_pair(col, equations.size()));
+      if(!is_temporary(col)) {
+        diags() << "Found dimensionless variable " << variables.name(col);
+        if(loc && *loc) {
+          diags() << " at ";
+          loc->print(diags());
+        }
+        diags() << '\n';
+      }
+    }
+  }
+
+  // Equations are never freed individually, so there's no need for them to each have their own heap block.
+  equation_term *terms = arena.Allocate<equation_term>(eqn.size());
+  std::uninitialized_copy(eqn.begin(), eqn.end(), terms);
+  equations.emplace_back(terms, eqn.size());
   locations.push_back(loc);
-  assert(equations.size() == locations.size());
+  blocks.push_back(current_block);
+  assert(equations.size() == locations.size() && equations.size() == blocks.size());
 }
 
 static RegisterPass<DimensionalAnalysis> dimens("dimens", "Dimensional Analysis", true, true);
@@ -1,14 +1,34 @@
 #ifndef DIMENSIONAL_ANALYSIS_H_
 #define DIMENSIONAL_ANALYSIS_H_
 
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/Pass.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/Timer.h>
+#include <chrono>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "DimensionlessSolver.h"
+#include "EchelonForm.h"
+#include "IncrementalEchelon.h"
+#include "PointsTo.h"
+#include "Presolve.h"
+#include "SolutionCache.h"
+
 namespace llvm {
+class AllocaInst;
+class BasicBlock;
+class CallSite;
 class DebugLoc;
 class DIVariable;
+class Function;
+class GEPOperator;
 class Instruction;
+class IntrinsicInst;
 class StructType;
 class Value;
 }
@@ -17,52 +37,184 @@ class TraceVariablesNg;
 
 struct dimens_var {
 public:
-  static const TraceVariablesNg *lookup;
+  // What the hash points to.
+  enum kind : unsigned char {VALUE, SOURCE, FIELD};
+
+  // Per-thread so that several modules can be analyzed at once.
+  static thread_local const TraceVariablesNg *lookup;
 
 private:
   unsigned long hash;
-  std::string str;
+  kind what;
   bool constant;
   llvm::DIVariable *svar;
 
-  dimens_var(const void *hash, std::string &&str = "", bool constant = false);
+  dimens_var(const void *hash, kind what, bool constant = false);
 
 public:
   dimens_var(const llvm::StructType &typ, const llvm::APInt &off);
   dimens_var(const llvm::DIVariable &var);
   dimens_var(llvm::Value &var);
-  virtual ~dimens_var();
 	bool operator==(const dimens_var &other) const;
 	operator unsigned long() const;
-  operator const std::string &() const;
 
   // Corresponding source pointer, if different from this var itself.
   operator llvm::DIVariable *() const;
   bool isa_constant() const;
+  kind which() const;
+  // Underlying program value, if there is one.
+  llvm::Value *value() const;
+
+  // Printable name, which is costly enough to build that we only do so on request.
+  std::string str() const;
+  static std::string str(unsigned long hash, kind what);
 };
 
-namespace std {
-template<>
-struct hash<dimens_var> : hash<unsigned long> {};
-}
+// The variable behind each column, stored field by field so that the parts scanned most often stay small and dense.
+class variable_table {
+public:
+  typedef std::vector<unsigned long>::size_type size_type;
+
+private:
+  std::vector<unsigned long> keys;
+  std::vector<dimens_var::kind> kinds;
+  std::vector<bool> temporaries;
+  // Filled in as they're asked for.
+  mutable std::vector<std::string> names;
+
+public:
+  size_type size() const;
+  void reserve(size_type);
+  void push_back(const dimens_var &, bool temporary);
+
+  bool temporary(size_type) const;
+  const std::string &name(size_type) const;
+};
 
 class DimensionalAnalysis : public llvm::ModulePass {
 private:
-  typedef std::vector<dimens_var>::size_type index_type;
+  typedef variable_table::size_type index_type;
 
   llvm::Module *module;
   index_type first_temporary;
   std::function<bool (index_type)> is_temporary;
 
-  std::unordered_map<dimens_var, index_type> indirections;
-  std::vector<dimens_var> variables;
-  std::unordered_map<dimens_var, index_type> indices;
-  std::vector<std::vector<int>> equations;
+  // An equation's nonzero coefficients, sorted by column.
+  typedef std::pair<index_type, int> equation_term;
+  typedef llvm::ArrayRef<equation_term> sparse_equation;
+  // Coefficients being gathered for a new equation, which seldom has more than a few.
+  typedef llvm::SmallVector<equation_term, 4> equation_builder;
+
+  // Keyed by the variables' hashes.
+  llvm::DenseMap<unsigned long, index_type> indirections;
+  variable_table variables;
+  llvm::DenseMap<unsigned long, index_type> indices;
+  // Whether each alloca we've come across is used only for plain loads and stores.
+  llvm::DenseMap<const llvm::AllocaInst *, bool> promotable;
+  // Which pointers might point to the same place, if we're merging them, and each such class's memory column.
+  PointsTo aliases;
+  llvm::DenseMap<const llvm::Value *, index_type> alias_columns;
+  // Holds the equations' terms until the analysis is done with them all.
+  llvm::BumpPtrAllocator arena;
+  std::vector<sparse_equation> equations;
   std::vector<const llvm::DebugLoc *> locations;
+  // Block each equation came from, if any, and the block currently being traversed.
+  std::vector<const llvm::BasicBlock *> blocks;
+  const llvm::BasicBlock *current_block;
   std::vector<int> dimensionless;
   std::vector<int> bad_eqns;
+  // How many source lines getBadEqns tried removing, out of how many it should have.
+  std::vector<int>::size_type lines_checked;
+  std::vector<int>::size_type lines_total;
   const TraceVariablesNg *groupings;
 
+  // The equations in the sparse form the solvers take.
+  equation_system system;
+
+  // Independent block of the equation system, which can be solved on its own.
+  struct subsystem {
+    // Our equation and variable indices for each of its rows and columns.
+    std::vector<int> rows;
+    std::vector<int> cols;
+    equation_system equations;
+    const DimensionlessSolver *solver;
+    // Forced-zero columns, in its own numbering.
+    std::vector<int> dimensionless;
+    // Its contents, as a key into the solution cache (if we have one).
+    std::string signature;
+    // Whether blame has been worked out yet, and if so, the first of its rows on each faulty line.
+    bool blamed;
+    std::vector<int> culprits;
+    // Lines that blame ran out of time to try, which leave it not fully blamed.
+    std::vector<unsigned> unchecked;
+  };
+  std::vector<subsystem> subsystems;
+  // For each equation, its subsystem and row therein (or -1 if it has no terms).
+  std::vector<std::pair<int, int>> row_homes;
+  // Total size of the subsystems before and after presolve.
+  struct presolve_sizes {
+    std::vector<equation_system::row>::size_type rows_before;
+    equation_system::column cols_before;
+    std::vector<equation_system::row>::size_type rows_after;
+    equation_system::column cols_after;
+  };
+  presolve_sizes presolved;
+  // Why we couldn't solve the system, if we couldn't.
+  std::string failure;
+  // Solutions from earlier runs to draw upon, if any.
+  SolutionCache *memo;
+  // Where to print findings ahead of the full report, if not outs().
+  llvm::raw_ostream *early;
+
+  // Running solution, if we're solving as we go.
+  IncrementalEchelon progress;
+  // Equation that first forced each forced-zero column.
+  llvm::DenseMap<index_type, int> forced_by;
+
+  // Relations each analyzed function imposes between its return value (slot 0) and formal parameters (slots 1+).
+  std::unordered_map<const llvm::Function *, std::vector<EchelonForm::row>> summaries;
+  // Members of the call graph SCC currently being processed.
+  std::unordered_set<const llvm::Function *> current_scc;
+
+  // The contiguous rows of each analyzed function, for solving them one function at a time.
+  std::vector<std::pair<std::vector<sparse_equation>::size_type, std::vector<sparse_equation>::size_type>> function_rows;
+
+  // How much of the equation system each function was responsible for.
+  struct function_cost {
+    const llvm::Function *function;
+    std::vector<sparse_equation>::size_type rows;
+    index_type cols;
+    std::vector<int>::size_type nonzeros;
+  };
+  std::vector<function_cost> costs;
+
+  // Column that a top-level lookup on one of a function's values resolved to.
+  struct resolution {
+    enum kind {VALUE, MEMORY, POINTER};
+    kind how;
+    unsigned long var;
+    index_type col;
+  };
+  // Analyzed function whose equations can be carried over to any other function of the same shape.
+  struct template_body {
+    const llvm::Function *function;
+    std::vector<sparse_equation>::size_type first_row;
+    std::vector<sparse_equation>::size_type last_row;
+    // Every lookup made while analyzing it, in order.
+    std::vector<resolution> resolutions;
+  };
+  std::unordered_map<std::string, template_body> templates;
+  // Where to note lookups, if we're currently analyzing a future template.
+  std::vector<resolution> *recording;
+  // How deeply the lookups are currently nested within each other.
+  unsigned nesting;
+
+  llvm::Timer traversal_timer;
+  llvm::Timer summary_timer;
+  llvm::Timer assembly_timer;
+  llvm::Timer solve_timer;
+  llvm::Timer blame_timer;
+
 public:
   static char ID;
 
@@ -74,11 +226,37 @@ public:
 
   void print(llvm::raw_ostream &, const llvm::Module *) const override;
 
+  // Reuse (and remember) the solutions of any subsystems this run has in common with others.
+  void reuse(SolutionCache *);
+
+  // Print whatever's known before the analysis finishes (with -dimens-stream or -dimens-blame-timeout) to this stream,
+  // which should be wherever print() is going to put the rest of the report.
+  void report_early(llvm::raw_ostream *);
+
 private:
+  void dump_matrix(const std::string &path) const;
+  void print_costs(llvm::raw_ostream &) const;
+  void print_dimensionless(llvm::raw_ostream &) const;
+  void print_component(llvm::raw_ostream &, const subsystem &, std::vector<subsystem>::size_type ordinal) const;
+
+  void focus();
+  bool plan();
+  const DimensionlessSolver *choose(const equation_system &, std::size_t budget);
   void calcDimensionless();
+  bool solve(const subsystem &, const std::vector<bool> *omit, std::vector<int> &forced, std::string &error,
+      presolve_sizes *tally = nullptr) const;
   void getBadEqns();
+  std::string signature(const subsystem &) const;
+  bool blame(subsystem &, std::chrono::steady_clock::time_point deadline, std::string &error) const;
+
+  void analyze_scc(const std::vector<llvm::Function *> &);
+  void summarize(llvm::Function &, std::vector<sparse_equation>::size_type first_row);
+  std::string shape(const llvm::Function &) const;
+  bool transplant(const template_body &, llvm::Function &);
 
   void instruction_opdecode(llvm::Instruction &);
+  void instruction_call(llvm::CallSite);
+  void instruction_intrinsic(llvm::IntrinsicInst &);
   void instruction_setequal(const dimens_var &dest, const dimens_var &src,
       const llvm::DebugLoc *loc = nullptr);
   void instruction_setequal(const dimens_var &dest, const dimens_var &src,
@@ -86,12 +264,20 @@ private:
   void instruction_setadditive(llvm::Instruction &line, int multiplier,
       const llvm::DebugLoc *loc = nullptr);
 
-  int &elem(std::vector<int> &, index_type);
+  int &elem(equation_builder &, index_type);
   index_type index_mem(const dimens_var &);
   index_type insert_mem(llvm::Value &);
+  index_type canonicalize_mem(llvm::Value &);
+  index_type index_field(llvm::GEPOperator &);
+  index_type index_alias(llvm::Value &representative);
   index_type index(const dimens_var &);
+  index_type lookup(const dimens_var &) const;
+  llvm::AllocaInst *forwarded(llvm::Value &);
+  // Pointer that a cast reinterprets as pointing to vectors of what it pointed to, if that's what it does.
+  static llvm::Value *widened(const llvm::Instruction &);
   index_type insert(const dimens_var &);
-  void equate(std::vector<int> &&, const llvm::DebugLoc *);
+  void record(resolution::kind, unsigned long var, index_type col);
+  void equate(equation_builder &&, const llvm::DebugLoc *);
 };
 
 #endif
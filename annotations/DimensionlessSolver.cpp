@@ -0,0 +1,288 @@
+#include "DimensionlessSolver.h"
+
+#include <llvm/ADT/Statistic.h>
+#include <lapacke.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#include "EchelonForm.h"
+#include "IncrementalEchelon.h"
+
+using std::iota;
+using std::min;
+using std::move;
+using std::numeric_limits;
+using std::size_t;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+#define DEBUG_TYPE "dimens"
+
+STATISTIC(NumSVDs, "Number of singular value decompositions performed");
+STATISTIC(NumEchelons, "Number of exact echelon forms computed");
+STATISTIC(NumSolverKiB, "Number of KiB allocated for solver matrices and workspaces");
+
+// Statistics are only 32 bits wide, which bytes would soon overflow, so count whole KiB instead.
+static void count_allocation(size_t bytes) {
+  NumSolverKiB += (bytes + 1023) >> 10;
+}
+
+equation_system::equation_system() :
+    cols(0),
+    rows() {}
+
+vector<equation_system::row>::size_type equation_system::nonzeros() const {
+  vector<row>::size_type res = 0;
+  for(const row &eqn : rows)
+    res += eqn.size();
+  return res;
+}
+
+static equation_system::column find_root(vector<equation_system::column> &parent, equation_system::column col) {
+  while(parent[col] != col)
+    col = parent[col] = parent[parent[col]];
+  return col;
+}
+
+vector<vector<int>> equation_system::partition() const {
+  // Union the columns of each row together.
+  vector<column> parent(cols);
+  iota(parent.begin(), parent.end(), 0);
+  for(const row &eqn : rows)
+    for(const auto &term : eqn) {
+      column lhs = find_root(parent, eqn.front().first), rhs = find_root(parent, term.first);
+      if(lhs != rhs)
+        parent[rhs] = lhs;
+    }
+
+  vector<vector<int>> res;
+  unordered_map<column, vector<vector<int>>::size_type> which;
+  for(vector<row>::size_type index = 0, count = rows.size(); index < count; ++index) {
+    if(rows[index].empty())
+      continue;
+    column root = find_root(parent, rows[index].front().first);
+    auto known = which.find(root);
+    if(known == which.end()) {
+      known = which.emplace(root, res.size()).first;
+      res.emplace_back();
+    }
+    res[known->second].push_back(index);
+  }
+  return res;
+}
+
+equation_system equation_system::extract(const vector<int> &which, vector<int> &outer) const {
+  equation_system res;
+  unordered_map<column, column> local;
+  outer.clear();
+  res.rows.reserve(which.size());
+  for(int index : which) {
+    row eqn = rows[index];
+    for(auto &term : eqn) {
+      auto known = local.find(term.first);
+      if(known == local.end()) {
+        known = local.emplace(term.first, outer.size()).first;
+        outer.push_back(term.first);
+      }
+      term.first = known->second;
+    }
+    std::sort(eqn.begin(), eqn.end());
+    res.rows.push_back(move(eqn));
+  }
+  res.cols = outer.size();
+  return res;
+}
+
+DimensionlessSolver::~DimensionlessSolver() = default;
+
+static vector<const DimensionlessSolver *> &registry() {
+  static vector<const DimensionlessSolver *> solvers;
+  return solvers;
+}
+
+const DimensionlessSolver *DimensionlessSolver::get(const string &name) {
+  for(const DimensionlessSolver *each : registry())
+    if(name == each->name())
+      return each;
+  return nullptr;
+}
+
+const vector<const DimensionlessSolver *> &DimensionlessSolver::all() {
+  return registry();
+}
+
+void DimensionlessSolver::add(const DimensionlessSolver *solver) {
+  assert(!get(solver->name()) && "ERROR: Solver registered twice!");
+  registry().push_back(solver);
+}
+
+namespace {
+// Floating-point singular value decomposition of the whole matrix at once; the reference implementation.
+class DenseSvdSolver : public DimensionlessSolver {
+public:
+  const char *name() const override {
+    return "dense";
+  }
+
+  size_t estimate(const equation_system &system) const override {
+    size_t rows = system.rows.size(), cols = system.cols;
+    if (!indexable(rows, cols))
+      return numeric_limits<size_t>::max();
+    return sizeof(double) * (rows*cols + rows+cols + (rows+cols)*30 + cols*cols);
+  }
+
+  bool solve(const equation_system &system, const vector<bool> *omit, vector<int> &res, string &error) const override {
+    size_t kept = system.rows.size();
+    if (omit)
+      kept -= count(omit->begin(), omit->end(), true);
+    res.clear();
+    if (!indexable(kept, system.cols)) {
+      error = "ERROR: A system of " + std::to_string(kept) + " equations in " + std::to_string(system.cols) +
+          " variables is too big for the dense solver";
+      return false;
+    }
+    int rows = kept;
+    int cols = system.cols;
+    if (rows == 0 || cols == 0)
+      return true;
+
+    char cN = 'N';
+    char cA = 'A';
+
+    double* A = new double[rows*cols]();
+    double* sigmas = new double[rows+cols];
+    int work_sz = (rows+cols)*30;
+    double* work = new double[work_sz];
+    double* Vt = new double[cols*cols];
+    int ldvt = cols;
+    int info;
+    count_allocation(sizeof(double) * ((size_t) rows*cols + rows+cols + work_sz + (size_t) cols*cols));
+
+    int i = 0;
+    for (int eqn = 0, count = system.rows.size(); eqn < count; ++eqn) {
+      if (omit && (*omit)[eqn])
+        continue;
+      for (const auto &term : system.rows[eqn])
+        A[i+term.first*rows] = term.second;
+      ++i;
+    }
+    assert(i == rows);
+
+    ++NumSVDs;
+    dgesvd_(&cN, &cA, &rows, &cols, A, &rows,
+            sigmas, NULL, &rows, Vt, &ldvt, work, &work_sz, &info);
+    assert(info == 0);
+
+    for (int i = min(cols, rows); i < cols; ++i)
+      sigmas[i] = 0;
+
+    const double eps = 1e-9;
+    for (int j = 0; j < cols; ++j) {
+      bool good = false;
+      for (int i = 0; i < cols; ++i) {
+        if (fabs(sigmas[i]) < eps && fabs(Vt[i+j*cols]) > eps) {
+          good = true;
+        }
+      }
+      if (!good) {
+        res.push_back(j);
+      }
+    }
+
+    delete[] A;
+    delete[] sigmas;
+    delete[] work;
+    delete[] Vt;
+    return true;
+  }
+
+private:
+  // Whether LAPACK, which takes every size and index as an int, can handle a matrix this big.
+  static bool indexable(size_t rows, size_t cols) {
+    size_t limit = numeric_limits<int>::max();
+    return rows <= limit && cols <= limit && (!rows || cols <= limit / rows) && (!cols || cols <= limit / cols) &&
+        rows + cols <= limit / 30;
+  }
+};
+
+// Exact integer elimination over the sparse rows.
+// A column is forced to zero exactly when the reduced echelon form contains it as a row all by itself.
+class SparseEchelonSolver : public DimensionlessSolver {
+public:
+  const char *name() const override {
+    return "sparse";
+  }
+
+  size_t estimate(const equation_system &system) const override {
+    // Assume that fill-in keeps reduced rows under a few dozen terms each, which holds for typical programs.
+    size_t rank = min<size_t>(system.rows.size(), system.cols);
+    size_t term = sizeof(EchelonForm::row::value_type);
+    return term * (system.nonzeros() + rank * min<size_t>(system.cols, 32)) + rank * 64;
+  }
+
+  bool solve(const equation_system &system, const vector<bool> *omit, vector<int> &res, string &error) const override {
+    EchelonForm form;
+    for(vector<equation_system::row>::size_type index = 0, count = system.rows.size(); index < count; ++index)
+      if(!omit || !(*omit)[index]) {
+        const equation_system::row &eqn = system.rows[index];
+        form.insert(EchelonForm::row(eqn.begin(), eqn.end()));
+      }
+    form.reduce();
+    ++NumEchelons;
+
+    res.clear();
+    size_t bytes = 0;
+    for(const auto &pivot : form.rows()) {
+      bytes += sizeof(EchelonForm::row::value_type) * pivot.second.size();
+      if(pivot.second.size() == 1)
+        res.push_back(pivot.first);
+    }
+    count_allocation(bytes);
+    return true;
+  }
+};
+
+// Exact elimination one row at a time, keeping the form fully reduced throughout, just as the analysis can while it
+// traverses the program.
+class IncrementalEchelonSolver : public DimensionlessSolver {
+public:
+  const char *name() const override {
+    return "incremental";
+  }
+
+  size_t estimate(const equation_system &system) const override {
+    // Like the sparse solver, plus an occurrence list entry for every term of every stored row.
+    size_t rank = min<size_t>(system.rows.size(), system.cols);
+    size_t term = sizeof(EchelonForm::row::value_type) + 2 * sizeof(void *);
+    return term * (system.nonzeros() + rank * min<size_t>(system.cols, 32)) + rank * 128;
+  }
+
+  bool solve(const equation_system &system, const vector<bool> *omit, vector<int> &res, string &error) const override {
+    IncrementalEchelon form;
+    for(vector<equation_system::row>::size_type index = 0, count = system.rows.size(); index < count; ++index)
+      if(!omit || !(*omit)[index]) {
+        const equation_system::row &eqn = system.rows[index];
+        form.insert(EchelonForm::row(eqn.begin(), eqn.end()));
+      }
+    ++NumEchelons;
+
+    size_t bytes = 0;
+    for(const auto &pivot : form.rows())
+      bytes += sizeof(EchelonForm::row::value_type) * pivot.second.size();
+    count_allocation(bytes);
+    res.assign(form.zeros().begin(), form.zeros().end());
+    std::sort(res.begin(), res.end());
+    return true;
+  }
+};
+}
+
+static RegisterSolver<DenseSvdSolver> dense;
+static RegisterSolver<SparseEchelonSolver> sparse;
+static RegisterSolver<IncrementalEchelonSolver> incremental;
@@ -0,0 +1,67 @@
+#ifndef DIMENSIONLESS_SOLVER_H_
+#define DIMENSIONLESS_SOLVER_H_
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Homogeneous system Ax = 0 relating the variables' degrees, stored as sparse rows.
+struct equation_system {
+  typedef unsigned column;
+  // Nonzero terms, sorted by column.
+  typedef std::vector<std::pair<column, int>> row;
+
+  column cols;
+  std::vector<row> rows;
+
+  equation_system();
+
+  std::vector<row>::size_type nonzeros() const;
+
+  // Split the rows into independent subsystems that share no columns.
+  // Columns that don't appear in any row are free, and so belong to no subsystem.
+  std::vector<std::vector<int>> partition() const;
+
+  // Copy out the given rows, renumbering the columns they touch consecutively from zero.
+  // Afterward, cols maps each of the subsystem's columns back to one of ours.
+  equation_system extract(const std::vector<int> &rows, std::vector<int> &cols) const;
+};
+
+// Strategy for finding the columns that every solution forces to zero, i.e. the dimensionless variables.
+class DimensionlessSolver {
+public:
+  virtual ~DimensionlessSolver();
+
+  virtual const char *name() const = 0;
+
+  // Approximate peak number of bytes that solving this system will allocate.
+  virtual std::size_t estimate(const equation_system &) const = 0;
+
+  // Find the sorted forced-zero columns, considering only those rows not flagged in omit (if provided).
+  // Returns false, with the reason in error, if the system couldn't be solved at all.
+  virtual bool solve(const equation_system &, const std::vector<bool> *omit, std::vector<int> &forced,
+      std::string &error) const = 0;
+
+  // Look up a registered solver, returning nullptr if there's none by that name.
+  static const DimensionlessSolver *get(const std::string &name);
+
+  // Every registered solver, in order of registration.
+  static const std::vector<const DimensionlessSolver *> &all();
+
+protected:
+  static void add(const DimensionlessSolver *);
+
+  template<typename T>
+  friend struct RegisterSolver;
+};
+
+// Make a solver available by name, in the manner of RegisterPass.
+template<typename T>
+struct RegisterSolver {
+  RegisterSolver() {
+    DimensionlessSolver::add(new T());
+  }
+};
+
+#endif
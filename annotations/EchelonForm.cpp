@@ -0,0 +1,122 @@
+#include "EchelonForm.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+using std::lower_bound;
+using std::map;
+using std::move;
+using std::pair;
+
+static EchelonForm::coefficient gcd(EchelonForm::coefficient lhs, EchelonForm::coefficient rhs) {
+  lhs = labs(lhs);
+  rhs = labs(rhs);
+  while(rhs) {
+    EchelonForm::coefficient rem = lhs % rhs;
+    lhs = rhs;
+    rhs = rem;
+  }
+  return lhs;
+}
+
+// Fraction-free elimination can grow the coefficients, so make sure they never silently wrap.
+EchelonForm::coefficient EchelonForm::checked_muladd(coefficient lscale, coefficient lhs, coefficient rscale,
+    coefficient rhs) {
+  __int128 res = (__int128) lscale * lhs + (__int128) rscale * rhs;
+  assert(res == (EchelonForm::coefficient) res && "ERROR: Coefficient overflow during exact elimination!");
+  return (EchelonForm::coefficient) res;
+}
+
+static EchelonForm::coefficient coefficient_of(const EchelonForm::row &eqn, EchelonForm::column col) {
+  auto term = lower_bound(eqn.begin(), eqn.end(), pair<EchelonForm::column, EchelonForm::coefficient>(col, 0),
+      [](const pair<EchelonForm::column, EchelonForm::coefficient> &lhs, const pair<EchelonForm::column, EchelonForm::coefficient> &rhs) {
+        return lhs.first < rhs.first;
+      });
+  assert(term != eqn.end() && term->first == col);
+  return term->second;
+}
+
+bool EchelonForm::insert(row &&eqn) {
+  while(!eqn.empty()) {
+    auto pivot = pivots.find(eqn.front().first);
+    if(pivot == pivots.end()) {
+      normalize(eqn);
+      column lead = eqn.front().first;
+      pivots.emplace(lead, move(eqn));
+      return true;
+    }
+    eliminate(eqn, pivot->second, pivot->first);
+  }
+  return false;
+}
+
+void EchelonForm::reduce() {
+  // Work upward, so the rows we substitute have already been reduced and can't reintroduce any pivots.
+  for(auto pivot = pivots.rbegin(), end = pivots.rend(); pivot != end; ++pivot) {
+    row &eqn = pivot->second;
+    for(row::size_type term = 1; term < eqn.size(); ) {
+      auto sub = pivots.find(eqn[term].first);
+      if(sub == pivots.end())
+        ++term;
+      else
+        // Every term before this one is either the lead or non-pivotal, and elimination only adds non-pivot columns.
+        eliminate(eqn, sub->second, sub->first);
+    }
+  }
+}
+
+const map<EchelonForm::column, EchelonForm::row> &EchelonForm::rows() const {
+  return pivots;
+}
+
+void EchelonForm::normalize(row &eqn) {
+  if(eqn.empty())
+    return;
+
+  coefficient factor = 0;
+  for(const pair<column, coefficient> &term : eqn)
+    factor = gcd(factor, term.second);
+  if(eqn.front().second < 0)
+    factor = -factor;
+  if(factor != 1)
+    for(pair<column, coefficient> &term : eqn)
+      term.second /= factor;
+}
+
+void EchelonForm::eliminate(row &from, const row &by, column col) {
+  coefficient lhs = coefficient_of(from, col);
+  coefficient rhs = coefficient_of(by, col);
+  coefficient factor = gcd(lhs, rhs);
+  coefficient lscale = rhs / factor;
+  coefficient rscale = -lhs / factor;
+
+  // Merge the two sorted rows, dropping anything that cancels.
+  row res;
+  res.reserve(from.size() + by.size());
+  auto lit = from.begin(), lend = from.end();
+  auto rit = by.begin(), rend = by.end();
+  while(lit != lend || rit != rend) {
+    column at;
+    coefficient val;
+    if(rit == rend || (lit != lend && lit->first < rit->first)) {
+      at = lit->first;
+      val = checked_muladd(lscale, lit->second, 0, 0);
+      ++lit;
+    } else if(lit == lend || rit->first < lit->first) {
+      at = rit->first;
+      val = checked_muladd(0, 0, rscale, rit->second);
+      ++rit;
+    } else {
+      at = lit->first;
+      val = checked_muladd(lscale, lit->second, rscale, rit->second);
+      ++lit;
+      ++rit;
+    }
+    if(val)
+      res.emplace_back(at, val);
+  }
+
+  normalize(res);
+  from = move(res);
+}
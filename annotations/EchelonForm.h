@@ -0,0 +1,40 @@
+#ifndef ECHELON_FORM_H_
+#define ECHELON_FORM_H_
+
+#include <map>
+#include <utility>
+#include <vector>
+
+// Exact row echelon form of a homogeneous integer system, built up one row at a time.
+// Every stored row's leading (i.e. lowest-numbered) column is unique among the stored rows.
+class EchelonForm {
+public:
+  typedef unsigned column;
+  typedef long coefficient;
+  // Nonzero terms, sorted by column.
+  typedef std::vector<std::pair<column, coefficient>> row;
+
+private:
+  std::map<column, row> pivots;
+
+public:
+  // Reduce the row against the ones already present, keeping it iff it turned out to be independent.
+  bool insert(row &&);
+
+  // Back-substitute so that no stored row mentions another's leading column.
+  void reduce();
+
+  // Stored rows, keyed by their leading column.
+  const std::map<column, row> &rows() const;
+
+  // Divide out the terms' common factor and make the leading coefficient positive.
+  static void normalize(row &);
+
+  // Cancel the named column out of the first row using the second, which must also contain it.
+  static void eliminate(row &from, const row &by, column col);
+
+  // lscale * lhs + rscale * rhs, asserting that it doesn't overflow.
+  static coefficient checked_muladd(coefficient lscale, coefficient lhs, coefficient rscale, coefficient rhs);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "IncrementalEchelon.h"
+
+#include <algorithm>
+#include <cassert>
+
+using std::move;
+using std::unordered_map;
+using std::vector;
+
+vector<IncrementalEchelon::column> IncrementalEchelon::insert(row &&eqn) {
+  // Stored rows mention no pivots but their own, so cancelling one pivot never disturbs the others.
+  vector<column> mentioned;
+  for(const auto &term : eqn)
+    if(pivots.count(term.first))
+      mentioned.push_back(term.first);
+  for(column col : mentioned)
+    EchelonForm::eliminate(eqn, pivots.at(col), col);
+  if(eqn.empty())
+    return vector<column>();
+  EchelonForm::normalize(eqn);
+
+  // Pivot on whichever column will take the fewest updates to clear out of the other rows.
+  column lead = eqn.front().first;
+  auto fewest = occurrences.find(lead);
+  for(const auto &term : eqn) {
+    auto each = occurrences.find(term.first);
+    if(each == occurrences.end()) {
+      lead = term.first;
+      fewest = each;
+      break;
+    }
+    if(fewest != occurrences.end() && each->second.size() < fewest->second.size()) {
+      lead = term.first;
+      fewest = each;
+    }
+  }
+
+  vector<column> res;
+  if(fewest != occurrences.end()) {
+    for(column pivot : fewest->second) {
+      row &other = pivots.at(pivot);
+      row before = other;
+      EchelonForm::eliminate(other, eqn, lead);
+
+      // Keep the occurrence lists in step with the row's new set of columns.
+      auto old = before.begin(), old_end = before.end();
+      auto now = other.begin(), now_end = other.end();
+      while(old != old_end || now != now_end)
+        if(now == now_end || (old != old_end && old->first < now->first)) {
+          if(old->first != pivot && old->first != lead)
+            occurrences[old->first].erase(pivot);
+          ++old;
+        } else if(old == old_end || now->first < old->first) {
+          occurrences[now->first].insert(pivot);
+          ++now;
+        } else {
+          ++old;
+          ++now;
+        }
+
+      if(other.size() == 1) {
+        assert(other.front().first == pivot);
+        res.push_back(pivot);
+      }
+    }
+    occurrences.erase(lead);
+  }
+
+  for(const auto &term : eqn)
+    if(term.first != lead)
+      occurrences[term.first].insert(lead);
+  if(eqn.size() == 1)
+    res.push_back(lead);
+  pivots.emplace(lead, move(eqn));
+
+  forced.insert(forced.end(), res.begin(), res.end());
+  return res;
+}
+
+const unordered_map<IncrementalEchelon::column, IncrementalEchelon::row> &IncrementalEchelon::rows() const {
+  return pivots;
+}
+
+const vector<IncrementalEchelon::column> &IncrementalEchelon::zeros() const {
+  return forced;
+}
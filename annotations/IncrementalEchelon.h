@@ -0,0 +1,36 @@
+#ifndef INCREMENTAL_ECHELON_H_
+#define INCREMENTAL_ECHELON_H_
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "EchelonForm.h"
+
+// Exact reduced row echelon form of a homogeneous integer system, kept up to date as each row arrives.
+// Because no stored row ever mentions another's pivot, a column is forced to zero as soon as its row is all alone,
+// and since rows are never removed it stays that way.
+class IncrementalEchelon {
+public:
+  typedef EchelonForm::column column;
+  typedef EchelonForm::coefficient coefficient;
+  typedef EchelonForm::row row;
+
+private:
+  std::unordered_map<column, row> pivots;
+  // For each non-pivot column, the pivots of the stored rows that mention it.
+  std::unordered_map<column, std::unordered_set<column>> occurrences;
+  std::vector<column> forced;
+
+public:
+  // Add a row, returning the columns that it caused to be forced to zero.
+  std::vector<column> insert(row &&);
+
+  // Stored rows, keyed by their pivot column.
+  const std::unordered_map<column, row> &rows() const;
+
+  // Forced-zero columns, in the order they became so.
+  const std::vector<column> &zeros() const;
+};
+
+#endif
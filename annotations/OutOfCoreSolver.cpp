@@ -0,0 +1,201 @@
+#include "DimensionlessSolver.h"
+
+#include <llvm/ADT/Statistic.h>
+#include <llvm/Support/CommandLine.h>
+#include <sys/mman.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+using namespace llvm;
+using std::max;
+using std::min;
+using std::numeric_limits;
+using std::size_t;
+using std::string;
+using std::vector;
+
+#define DEBUG_TYPE "dimens"
+
+STATISTIC(NumScratchKiB, "Number of KiB of equations spilled to scratch files");
+STATISTIC(NumPanels, "Number of column panels eliminated out of core");
+
+static cl::opt<string> scratch_dir("dimens-scratch-dir",
+    cl::desc("Directory for the out-of-core solver's memory-mapped files (default: $TMPDIR or /tmp)"),
+    cl::value_desc("directory"));
+
+static cl::opt<unsigned> panel_mib("dimens-panel-size",
+    cl::desc("Size of each column panel the out-of-core solver works on at once, in MiB"),
+    cl::value_desc("MiB"), cl::init(64));
+
+static string scratch() {
+  if(scratch_dir.size())
+    return scratch_dir;
+  if(const char *tmp = getenv("TMPDIR"))
+    return tmp;
+  return "/tmp";
+}
+
+namespace {
+// Gauss-Jordan elimination over a dense column-major copy of the matrix that lives in a memory-mapped scratch file.
+// Columns are eliminated a panel at a time, and each panel's row operations are then swept across the other columns,
+// so only about one panel has to be resident at once; the operating system pages the rest in and out as needed.
+class OutOfCoreSolver : public DimensionlessSolver {
+public:
+  const char *name() const override {
+    return "out-of-core";
+  }
+
+  size_t estimate(const equation_system &system) const override {
+    size_t rows = system.rows.size(), cols = system.cols;
+    size_t spilled = sizeof(double) * rows * cols;
+
+    // We can't spill what won't fit on disk, or to a directory that isn't there at all.
+    struct statvfs disk;
+    if(statvfs(scratch().c_str(), &disk) || (size_t) disk.f_bavail * disk.f_frsize < spilled)
+      return numeric_limits<size_t>::max();
+
+    // Bookkeeping plus the working panel.
+    return sizeof(int) * (rows + cols) + rows + cols + min(spilled, panel_bytes());
+  }
+
+  bool solve(const equation_system &system, const vector<bool> *omit, vector<int> &res, string &error) const override {
+    size_t rows = system.rows.size();
+    size_t cols = system.cols;
+    if(omit)
+      rows -= count(omit->begin(), omit->end(), true);
+    res.clear();
+    if(!rows || !cols)
+      return true;
+
+    size_t bytes = sizeof(double) * rows * cols;
+    double *matrix = map_scratch(bytes, error);
+    if(!matrix)
+      return false;
+    // In KiB, since a 32-bit count of bytes would overflow at just the sizes this solver is for.
+    NumScratchKiB += (bytes + 1023) >> 10;
+
+    // Spill the equations, one column after another; the file starts out zeroed.
+    size_t next = 0;
+    for(vector<equation_system::row>::size_type eqn = 0, count = system.rows.size(); eqn < count; ++eqn) {
+      if(omit && (*omit)[eqn])
+        continue;
+      for(const auto &term : system.rows[eqn])
+        matrix[term.first * rows + next] = term.second;
+      ++next;
+    }
+    assert(next == rows);
+
+    const double eps = 1e-9;
+    vector<int> pivot_row(cols, -1);
+    vector<char> row_used(rows);
+    size_t width = max<size_t>(1, panel_bytes() / (sizeof(double) * rows));
+    for(size_t first = 0; first < cols; first += width) {
+      size_t last = min(cols, first + width);
+      vector<size_t> pivots;
+
+      for(size_t col = first; col < last; ++col) {
+        double *column = matrix + col * rows;
+        size_t best = rows;
+        for(size_t row = 0; row < rows; ++row)
+          if(!row_used[row] && fabs(column[row]) > eps && (best == rows || fabs(column[row]) > fabs(column[best])))
+            best = row;
+        if(best == rows)
+          // Nothing left to pivot on, so this column is free.
+          continue;
+
+        row_used[best] = true;
+        pivot_row[col] = best;
+        pivots.push_back(col);
+
+        // From here on, the pivot column holds the multiplier for each row.
+        double pivot = column[best];
+        for(size_t row = 0; row < rows; ++row)
+          if(row != best)
+            column[row] /= pivot;
+
+        // Clear this column out of every other row, but only within the panel for now.
+        for(size_t other = first; other < last; ++other)
+          if(other != col && pivot_row[other] < 0)
+            sweep(matrix, rows, col, best, other);
+      }
+
+      // Now carry the panel's row operations across every other column that isn't already a pivot.
+      for(size_t other = 0; other < cols; ++other)
+        if((other < first || other >= last) && pivot_row[other] < 0)
+          for(size_t col : pivots)
+            sweep(matrix, rows, col, pivot_row[col], other);
+
+      // We won't be back to this panel's columns, except to read the free ones at the end.
+      madvise(matrix + first * rows, (last - first) * rows * sizeof(double), MADV_DONTNEED);
+      ++NumPanels;
+    }
+
+    // In reduced form, a pivot's column is forced to zero iff its row is zero across all the free columns.
+    vector<char> busy(rows);
+    for(size_t col = 0; col < cols; ++col)
+      if(pivot_row[col] < 0) {
+        const double *column = matrix + col * rows;
+        for(size_t row = 0; row < rows; ++row)
+          if(row_used[row] && fabs(column[row]) > eps)
+            busy[row] = true;
+      }
+
+    for(size_t col = 0; col < cols; ++col)
+      if(pivot_row[col] >= 0 && !busy[pivot_row[col]])
+        res.push_back(col);
+
+    munmap(matrix, bytes);
+    return true;
+  }
+
+private:
+  static size_t panel_bytes() {
+    return (size_t) panel_mib << 20;
+  }
+
+  // Subtract the multiple of the pivot row that clears the given column's entry in every other row.
+  static void sweep(double *matrix, size_t rows, size_t col, size_t pivot, size_t other) {
+    const double *multipliers = matrix + col * rows;
+    double *column = matrix + other * rows;
+    double scale = column[pivot];
+    if(scale == 0)
+      return;
+    for(size_t row = 0; row < rows; ++row)
+      if(row != pivot)
+        column[row] -= multipliers[row] * scale;
+  }
+
+  static double *map_scratch(size_t bytes, string &error) {
+    string path = scratch() + "/dimens-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if(fd < 0) {
+      error = "ERROR: Couldn't create scratch file in " + scratch() + ": " + strerror(errno);
+      return nullptr;
+    }
+    // Nobody else needs to see it, and this way it disappears even if we crash.
+    unlink(path.c_str());
+
+    void *res = MAP_FAILED;
+    if(!ftruncate(fd, bytes))
+      res = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int cause = errno;
+    close(fd);
+    if(res == MAP_FAILED) {
+      error = "ERROR: Couldn't map " + std::to_string(bytes >> 20) + " MiB scratch file in " + scratch() + ": " +
+          strerror(cause);
+      return nullptr;
+    }
+    return (double *) res;
+  }
+};
+}
+
+static RegisterSolver<OutOfCoreSolver> out_of_core;
@@ -0,0 +1,113 @@
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/PassRegistry.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+#include <fstream>
+
+#include "DimensionalAnalysis.h"
+#include "Diagnostics.h"
+
+using namespace llvm;
+using std::string;
+using std::unique_ptr;
+
+static cl::opt<string> report_path("dimens-report-file",
+    cl::desc("When running within the compiler, write the report here instead of next to the object file"),
+    cl::value_desc("file"));
+
+// The file the compiler was told to write its output to, or an empty string if we can't tell.
+// The plugin has no other way to see the frontend's options, but on Linux its command line is in /proc.
+static string output_path() {
+  std::ifstream cmdline("/proc/self/cmdline");
+  string arg;
+  while(std::getline(cmdline, arg, '\0'))
+    if(arg == "-o" && std::getline(cmdline, arg, '\0'))
+      return arg == "-" ? "" : arg;
+  return "";
+}
+
+namespace {
+// Runs the analysis from within the compiler's own pipeline and writes its report to a sidecar file.
+class DimensionalReport : public ModulePass {
+private:
+  bool promote;
+
+public:
+  static char ID;
+
+  explicit DimensionalReport(bool promote = false) :
+      ModulePass(ID),
+      promote(promote) {}
+
+  void getAnalysisUsage(AnalysisUsage &info) const override {
+    info.setPreservesAll();
+  }
+
+  bool runOnModule(Module &module) override {
+    // Don't let TraceVariablesNg bring down the compiler.
+    if(!module.getNamedMetadata("llvm.dbg.cu")) {
+      errs() << "WARNING: Skipping dimensional analysis of " << module.getModuleIdentifier() << ", which lacks debugging symbols\n";
+      return false;
+    }
+    if(!PassRegistry::getPassRegistry()->getPassInfo("tracevarsng")) {
+      errs() << "ERROR: Dimensional analysis needs TraceVariablesNg.so to be loaded as well\n";
+      return false;
+    }
+
+    string path = report_path;
+    if(path.empty()) {
+      // Next to the object file, or failing that, the source file.
+      string output = output_path();
+      SmallString<128> sidecar(output.size() ? output : module.getModuleIdentifier());
+      sys::path::replace_extension(sidecar, "dimens");
+      path = sidecar.str();
+    }
+    std::error_code err;
+    raw_fd_ostream report(path, err, sys::fs::F_Text);
+    if(err) {
+      errs() << "ERROR: Couldn't write dimensional analysis report to " << path << ": " << err.message() << '\n';
+      return false;
+    }
+
+    // An unoptimized build never promotes its locals to registers, so do that to a copy we can throw away afterward.
+    legacy::PassManager passes;
+    unique_ptr<Module> copy;
+    Module *target = &module;
+    if(promote) {
+      copy = CloneModule(&module);
+      target = copy.get();
+      passes.add(createPromoteMemoryToRegisterPass());
+    }
+    DimensionalAnalysis *dimens = new DimensionalAnalysis();
+    dimens->report_early(&report);
+    passes.add(dimens);
+
+    // The per-instruction chatter has no place amid the compiler's diagnostics.
+    redirect_diags(&nulls());
+    passes.run(*target);
+    redirect_diags(nullptr);
+    dimens->print(report, target);
+    return false;
+  }
+};
+}
+
+char DimensionalReport::ID = 0;
+
+static RegisterPass<DimensionalReport> report("dimens-report", "Dimensional analysis report", false, true);
+
+static void add_report(const PassManagerBuilder &builder, legacy::PassManagerBase &passes) {
+  passes.add(new DimensionalReport(builder.OptLevel == 0));
+}
+
+// By the time the module optimizer starts, the per-function passes have already promoted locals to registers.
+static RegisterStandardPasses optimized(PassManagerBuilder::EP_ModuleOptimizerEarly, add_report);
+static RegisterStandardPasses unoptimized(PassManagerBuilder::EP_EnabledOnOptLevel0, add_report);
@@ -0,0 +1,188 @@
+#include "PointsTo.h"
+
+#include <llvm/IR/CallSite.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Operator.h>
+
+using namespace llvm;
+using std::make_pair;
+using std::pair;
+using std::vector;
+
+// Whether the value is a pointer that could point somewhere in particular.
+static bool tracked(const Value *val) {
+  return val->getType()->getScalarType()->isPointerTy() && !isa<ConstantPointerNull>(val) && !isa<UndefValue>(val);
+}
+
+void PointsTo::build(Module &module, bool across_calls) {
+  *this = PointsTo();
+  DataLayout layout(&module);
+  auto relate = [this](Value *lhs, Value *rhs) {
+    if(tracked(lhs) && tracked(rhs))
+      unify(node(*lhs), node(*rhs));
+  };
+
+  for(Function &function : module)
+    for(BasicBlock &block : function)
+      for(Instruction &inst : block) {
+        if(GEPOperator *gep = dyn_cast<GEPOperator>(&inst)) {
+          PointerType *point = dyn_cast<PointerType>(gep->getPointerOperandType());
+          if(!point)
+            continue;
+          StructType *struct_ty = dyn_cast<StructType>(point->getElementType());
+          if(!struct_ty) {
+            // Pointer arithmetic stays within the same object.
+            relate(gep, gep->getPointerOperand());
+            continue;
+          }
+
+          APInt offset(layout.getPointerSizeInBits(point->getAddressSpace()), 0);
+          if(gep->accumulateConstantOffset(layout, offset)) {
+            auto known = fields.find(make_pair(struct_ty, offset.getZExtValue()));
+            if(known == fields.end()) {
+              known = fields.insert(make_pair(make_pair(struct_ty, offset.getZExtValue()), (unsigned) parent.size())).first;
+              parent.push_back(parent.size());
+              pointee.push_back(-1);
+              values.push_back(nullptr);
+            }
+            unify(known->second, node(*gep));
+          }
+          continue;
+        }
+
+        switch(inst.getOpcode()) {
+          case Instruction::BitCast:
+          case Instruction::AddrSpaceCast:
+          case Instruction::PHI:
+            for(Use &op : inst.operands())
+              relate(&inst, op);
+            break;
+
+          case Instruction::Select:
+            relate(&inst, inst.getOperand(1));
+            relate(&inst, inst.getOperand(2));
+            break;
+
+          case Instruction::Load:
+            if(tracked(&inst))
+              unify(node(inst), pointee_of(node(*inst.getOperand(0))));
+            break;
+
+          case Instruction::Store:
+            if(tracked(inst.getOperand(0)))
+              unify(pointee_of(node(*inst.getOperand(1))), node(*inst.getOperand(0)));
+            break;
+
+          case Instruction::Ret:
+            // The function itself stands for its return value.
+            if(inst.getNumOperands())
+              relate(&function, inst.getOperand(0));
+            break;
+
+          case Instruction::Call:
+          case Instruction::Invoke: {
+            if(MemTransferInst *copy = dyn_cast<MemTransferInst>(&inst)) {
+              // Whatever pointers were in the source are now in the destination, too.
+              unify(pointee_of(node(*copy->getRawDest())), pointee_of(node(*copy->getRawSource())));
+              break;
+            }
+
+            CallSite call(&inst);
+            Function *callee = call.getCalledFunction();
+            if(!across_calls || !callee || callee->isDeclaration())
+              break;
+            Function::arg_iterator formal = callee->arg_begin(), formal_end = callee->arg_end();
+            for(auto actual = call.arg_begin(), end = call.arg_end(); actual != end && formal != formal_end; ++actual, ++formal)
+              relate(&*formal, *actual);
+            relate(&inst, callee);
+            break;
+          }
+        }
+      }
+
+  // Name each class after its earliest member, and note whether it has a field we can index its memory by.
+  representatives.assign(parent.size(), nullptr);
+  field_addresses.assign(parent.size(), nullptr);
+  sizes.assign(parent.size(), 0);
+  for(unsigned each = 0, count = parent.size(); each < count; ++each) {
+    unsigned root = find(each);
+    ++sizes[root];
+    if(!values[each])
+      continue;
+    if(!representatives[root])
+      representatives[root] = values[each];
+    if(!field_addresses[root])
+      if(GEPOperator *gep = dyn_cast<GEPOperator>(values[each]))
+        if(PointerType *point = dyn_cast<PointerType>(gep->getPointerOperandType()))
+          if(isa<StructType>(point->getElementType()) && gep->hasAllConstantIndices())
+            field_addresses[root] = gep;
+  }
+}
+
+Value *PointsTo::representative(const Value &val) const {
+  auto known = nodes.find(&val);
+  if(known == nodes.end())
+    return nullptr;
+  unsigned root = find(known->second);
+  return sizes[root] > 1 ? representatives[root] : nullptr;
+}
+
+GEPOperator *PointsTo::field(const Value &representative) const {
+  auto known = nodes.find(&representative);
+  return known == nodes.end() ? nullptr : field_addresses[find(known->second)];
+}
+
+unsigned PointsTo::find(unsigned each) const {
+  while(parent[each] != each)
+    each = parent[each] = parent[parent[each]];
+  return each;
+}
+
+unsigned PointsTo::node(Value &val) {
+  auto known = nodes.find(&val);
+  if(known != nodes.end())
+    return known->second;
+
+  unsigned res = parent.size();
+  nodes.insert(make_pair(&val, res));
+  parent.push_back(res);
+  pointee.push_back(-1);
+  values.push_back(&val);
+  return res;
+}
+
+unsigned PointsTo::pointee_of(unsigned each) {
+  unsigned root = find(each);
+  if(pointee[root] < 0) {
+    unsigned res = parent.size();
+    parent.push_back(res);
+    pointee.push_back(-1);
+    values.push_back(nullptr);
+    pointee[root] = res;
+  }
+  return pointee[root];
+}
+
+void PointsTo::unify(unsigned lhs, unsigned rhs) {
+  // Merging two classes merges what they point to, and so on down.
+  vector<pair<unsigned, unsigned>> work = {{lhs, rhs}};
+  while(work.size()) {
+    unsigned left = find(work.back().first), right = find(work.back().second);
+    work.pop_back();
+    if(left == right)
+      continue;
+
+    // Keep the lower-numbered root so that each class goes by its earliest member.
+    if(right < left)
+      std::swap(left, right);
+    parent[right] = left;
+    if(pointee[left] < 0)
+      pointee[left] = pointee[right];
+    else if(pointee[right] >= 0)
+      work.emplace_back(pointee[left], pointee[right]);
+  }
+}
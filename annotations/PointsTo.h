@@ -0,0 +1,52 @@
+#ifndef POINTS_TO_H_
+#define POINTS_TO_H_
+
+#include <llvm/ADT/DenseMap.h>
+
+#include <utility>
+#include <vector>
+
+namespace llvm {
+class GEPOperator;
+class Module;
+class StructType;
+class Value;
+}
+
+// Steensgaard-style alias classes: pointers that might point to the same place are unified, along with whatever
+// they point to in turn. Addresses of the same struct field all join one class, since the analysis treats each field
+// as a single location shared by every instance.
+class PointsTo {
+private:
+  // Union-find forest over the nodes, which lookups flatten as they go.
+  mutable std::vector<unsigned> parent;
+  // Node standing for the locations each class's pointers point to, or -1 if none has been needed yet.
+  std::vector<int> pointee;
+  // Program value behind each node, or null for pointees and fields.
+  std::vector<llvm::Value *> values;
+  llvm::DenseMap<const llvm::Value *, unsigned> nodes;
+  llvm::DenseMap<std::pair<llvm::StructType *, unsigned long>, unsigned> fields;
+
+  // Filled in by build(), by root.
+  std::vector<llvm::Value *> representatives;
+  std::vector<llvm::GEPOperator *> field_addresses;
+  std::vector<unsigned> sizes;
+
+public:
+  // Unify over the whole module, binding actual to formal parameters across direct calls if asked to.
+  void build(llvm::Module &, bool across_calls);
+
+  // Earliest member of the pointer's class, or null if nothing else shares it.
+  llvm::Value *representative(const llvm::Value &) const;
+
+  // Some struct field address in the class of the given representative, if there's one.
+  llvm::GEPOperator *field(const llvm::Value &representative) const;
+
+private:
+  unsigned find(unsigned) const;
+  unsigned node(llvm::Value &);
+  unsigned pointee_of(unsigned);
+  void unify(unsigned, unsigned);
+};
+
+#endif
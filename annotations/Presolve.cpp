@@ -0,0 +1,204 @@
+#include "Presolve.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+
+#include "EchelonForm.h"
+
+using std::deque;
+using std::map;
+using std::move;
+using std::pair;
+using std::vector;
+
+static bool mentions(const EchelonForm::row &eqn, EchelonForm::column col) {
+  return binary_search(eqn.begin(), eqn.end(), EchelonForm::row::value_type(col, 0),
+      [](const EchelonForm::row::value_type &lhs, const EchelonForm::row::value_type &rhs) {
+        return lhs.first < rhs.first;
+      });
+}
+
+Presolve::Presolve(const equation_system &system, const vector<bool> *omit) :
+    remaining(),
+    cols(),
+    forced(),
+    original_rows(0),
+    original_cols(system.cols) {
+  vector<EchelonForm::row> rows;
+  for(vector<equation_system::row>::size_type index = 0, count = system.rows.size(); index < count; ++index)
+    if(!omit || !(*omit)[index]) {
+      const equation_system::row &eqn = system.rows[index];
+      rows.emplace_back(eqn.begin(), eqn.end());
+      EchelonForm::normalize(rows.back());
+    }
+  original_rows = rows.size();
+
+  // Which rows each column appears in; entries go stale as rows die or lose terms, so always double-check.
+  vector<vector<int>> occurrences(system.cols);
+  vector<int> counts(system.cols);
+  for(int row = 0, count = rows.size(); row < count; ++row)
+    for(const auto &term : rows[row]) {
+      occurrences[term.first].push_back(row);
+      ++counts[term.first];
+    }
+
+  vector<char> alive(rows.size(), true);
+  // Each absorbing column and its row, in order of removal.
+  vector<pair<EchelonForm::column, EchelonForm::row>> absorbed;
+  vector<char> removed(system.cols);
+  vector<char> zero(system.cols);
+  deque<int> row_work, col_work;
+  auto kill = [&](int row) {
+    alive[row] = false;
+    for(const auto &term : rows[row])
+      if(!removed[term.first] && --counts[term.first] == 1)
+        col_work.push_back(term.first);
+  };
+
+  for(int row = 0, count = rows.size(); row < count; ++row)
+    row_work.push_back(row);
+  for(equation_system::column col = 0; col < system.cols; ++col)
+    col_work.push_back(col);
+
+  bool progress = true;
+  while(progress) {
+    while(row_work.size() || col_work.size()) {
+      if(row_work.size()) {
+        int row = row_work.front();
+        row_work.pop_front();
+        if(!alive[row] || rows[row].size() > 1)
+          continue;
+        if(rows[row].empty()) {
+          kill(row);
+          continue;
+        }
+
+        // Singleton row: the column must be zero, so substitute that everywhere else.
+        EchelonForm::column col = rows[row].front().first;
+        kill(row);
+        removed[col] = zero[col] = true;
+        for(int other : occurrences[col])
+          if(alive[other] && mentions(rows[other], col)) {
+            EchelonForm::row &eqn = rows[other];
+            eqn.erase(remove_if(eqn.begin(), eqn.end(), [col](const EchelonForm::row::value_type &term) {
+              return term.first == col;
+            }), eqn.end());
+            EchelonForm::normalize(eqn);
+            row_work.push_back(other);
+          }
+      } else {
+        EchelonForm::column col = col_work.front();
+        col_work.pop_front();
+        if(removed[col] || counts[col] != 1)
+          continue;
+
+        int home = -1;
+        for(int row : occurrences[col])
+          if(alive[row] && mentions(rows[row], col)) {
+            home = row;
+            break;
+          }
+        if(rows[home].size() < 2)
+          // That's a singleton row, which is the other case.
+          continue;
+
+        // Column singleton: whatever the rest of the row comes to, this column can balance it out.
+        absorbed.emplace_back(col, rows[home]);
+        removed[col] = true;
+        kill(home);
+      }
+    }
+
+    // Drop duplicates, which might leave some columns in just one row and so start the whole thing over again.
+    progress = false;
+    map<EchelonForm::row, int> distinct;
+    for(int row = 0, count = rows.size(); row < count; ++row)
+      if(alive[row] && !distinct.emplace(rows[row], row).second) {
+        kill(row);
+        progress = true;
+      }
+  }
+
+  // Whatever's left goes to the solver, renumbered.
+  vector<int> local(system.cols, -1);
+  auto add = [&](const EchelonForm::row &eqn) {
+    equation_system::row res;
+    for(const auto &term : eqn) {
+      if(local[term.first] < 0) {
+        local[term.first] = cols.size();
+        cols.push_back(term.first);
+      }
+      res.emplace_back(local[term.first], (int) term.second);
+    }
+    std::sort(res.begin(), res.end());
+    remaining.rows.push_back(move(res));
+  };
+  for(int row = 0, count = rows.size(); row < count; ++row)
+    if(alive[row])
+      add(rows[row]);
+
+  // Anything that's neither eliminated nor left for the solver has lost all its rows, so it's entirely unconstrained.
+  auto unconstrained = [&](EchelonForm::column col) {
+    return !removed[col] && local[col] < 0;
+  };
+
+  // Now revisit the set-aside rows, latest first so that the absorbing columns they mention are already settled.
+  // A settled column that isn't forced is a combination of the others in its row, which we substitute in to get down
+  // to columns that are either unconstrained or the solver's business.
+  map<EchelonForm::column, EchelonForm::row> definitions;
+  for(auto each = absorbed.rbegin(), end = absorbed.rend(); each != end; ++each) {
+    EchelonForm::column col = each->first;
+    EchelonForm::row &eqn = each->second;
+    for(bool substituted = true; substituted;) {
+      substituted = false;
+      for(const auto &term : eqn) {
+        auto defined = definitions.find(term.first);
+        if(term.first != col && defined != definitions.end()) {
+          EchelonForm::eliminate(eqn, defined->second, term.first);
+          substituted = true;
+          break;
+        }
+      }
+    }
+    eqn.erase(remove_if(eqn.begin(), eqn.end(), [&zero](const EchelonForm::row::value_type &term) {
+      return zero[term.first];
+    }), eqn.end());
+    EchelonForm::normalize(eqn);
+
+    if(eqn.size() == 1)
+      zero[col] = true;
+    else if(any_of(eqn.begin(), eqn.end(), [&](const EchelonForm::row::value_type &term) {
+      return unconstrained(term.first);
+    }))
+      definitions.emplace(col, move(eqn));
+    else
+      // Whether the rest of the row always cancels out is a question for the solver.
+      add(eqn);
+  }
+  remaining.cols = cols.size();
+
+  for(EchelonForm::column col = 0; col < system.cols; ++col)
+    if(zero[col])
+      forced.push_back(col);
+}
+
+const equation_system &Presolve::reduced() const {
+  return remaining;
+}
+
+vector<int> Presolve::expand(const vector<int> &zeros) const {
+  vector<int> res(forced);
+  for(int col : zeros)
+    res.push_back(cols[col]);
+  std::sort(res.begin(), res.end());
+  return res;
+}
+
+vector<equation_system::row>::size_type Presolve::rows_before() const {
+  return original_rows;
+}
+
+equation_system::column Presolve::cols_before() const {
+  return original_cols;
+}
@@ -0,0 +1,36 @@
+#ifndef PRESOLVE_H_
+#define PRESOLVE_H_
+
+#include <vector>
+
+#include "DimensionlessSolver.h"
+
+// Exact reductions that shrink a system before it's handed to a solver, in the manner of an LP presolve:
+//  - empty and duplicate rows are dropped;
+//  - a row with a single column forces that column to zero, which is then substituted into the other rows; and
+//  - a column in only one row can absorb any value, so that row constrains nothing else and is set aside.
+// These are repeated until none applies. Each set-aside row then either settles its column by itself (because the rest
+// of the row is forced to zero, or mentions a column that nothing constrains), or goes back to the solver.
+class Presolve {
+private:
+  equation_system remaining;
+  // Reduced column numbering to original.
+  std::vector<int> cols;
+  // Columns found to be forced to zero along the way.
+  std::vector<int> forced;
+  std::vector<equation_system::row>::size_type original_rows;
+  equation_system::column original_cols;
+
+public:
+  Presolve(const equation_system &, const std::vector<bool> *omit = nullptr);
+
+  const equation_system &reduced() const;
+
+  // The original system's sorted forced-zero columns, given those of the reduced one.
+  std::vector<int> expand(const std::vector<int> &) const;
+
+  std::vector<equation_system::row>::size_type rows_before() const;
+  equation_system::column cols_before() const;
+};
+
+#endif
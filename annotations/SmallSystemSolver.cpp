@@ -0,0 +1,151 @@
+#include "DimensionlessSolver.h"
+
+#include <llvm/ADT/Statistic.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#include "EchelonForm.h"
+
+using std::numeric_limits;
+using std::size_t;
+using std::string;
+using std::vector;
+
+#define DEBUG_TYPE "dimens"
+
+STATISTIC(NumSmallSystems, "Number of systems solved by fixed-size kernels");
+
+namespace {
+typedef EchelonForm::coefficient coefficient;
+
+// Divide out the terms' common factor and make the first nonzero one positive.
+template<unsigned N>
+void normalize(coefficient (&row)[N]) {
+  coefficient factor = 0;
+  for(unsigned col = 0; col < N; ++col)
+    for(coefficient rest = std::labs(row[col]); rest;) {
+      coefficient next = factor % rest;
+      factor = rest;
+      rest = next;
+    }
+  if(!factor)
+    return;
+
+  for(unsigned col = 0; col < N; ++col)
+    if(row[col]) {
+      if(row[col] < 0)
+        factor = -factor;
+      break;
+    }
+  for(unsigned col = 0; col < N; ++col)
+    row[col] /= factor;
+}
+
+// Cancel column col out of the first row using the second, which must have a nonzero there.
+template<unsigned N>
+void eliminate(coefficient (&from)[N], const coefficient (&by)[N], unsigned col) {
+  coefficient scale = from[col], pivot = by[col];
+  for(unsigned each = 0; each < N; ++each)
+    from[each] = EchelonForm::checked_muladd(pivot, from[each], -scale, by[each]);
+  normalize(from);
+}
+
+// Exact reduced row echelon form of a system of at most N columns, in fixed-size arrays so that nothing is allocated.
+// (The answer goes into the caller's vector, which can reuse whatever room it already has.)
+// Every loop runs a compile-time number of times, so the compiler can unroll them all.
+template<unsigned N>
+class fixed_echelon {
+private:
+  // The stored row whose leading column is each column, if there is one.
+  coefficient pivots[N][N];
+  bool present[N];
+
+public:
+  fixed_echelon() :
+      present() {}
+
+  void insert(const equation_system::row &eqn) {
+    coefficient row[N] = {};
+    for(const auto &term : eqn)
+      row[term.first] = term.second;
+
+    // No stored row mentions another's leading column, so one pass clears them all out of the new row.
+    for(unsigned col = 0; col < N; ++col)
+      if(row[col] && present[col])
+        eliminate(row, pivots[col], col);
+
+    unsigned lead = 0;
+    while(lead < N && !row[lead])
+      ++lead;
+    if(lead == N)
+      return;
+
+    // Keep the form fully reduced by clearing the new leading column out of the others.
+    normalize(row);
+    for(unsigned col = 0; col < N; ++col)
+      if(present[col] && pivots[col][lead])
+        eliminate(pivots[col], row, lead);
+    std::copy(row, row + N, pivots[lead]);
+    present[lead] = true;
+  }
+
+  // A column is forced to zero exactly when it's a stored row all by itself.
+  void zeros(vector<int> &res) const {
+    res.clear();
+    for(unsigned col = 0; col < N; ++col)
+      if(present[col] && (unsigned) std::count(pivots[col], pivots[col] + N, 0) == N - 1)
+        res.push_back(col);
+  }
+};
+
+template<unsigned N>
+void solve_fixed(const equation_system &system, const vector<bool> *omit, vector<int> &forced) {
+  fixed_echelon<N> form;
+  for(vector<equation_system::row>::size_type index = 0, count = system.rows.size(); index < count; ++index)
+    if(!omit || !(*omit)[index])
+      form.insert(system.rows[index]);
+  form.zeros(forced);
+}
+
+// Kernels for each width, the narrowest one that fits being chosen for each system.
+const struct {
+  unsigned cols;
+  void (*solve)(const equation_system &, const vector<bool> *, vector<int> &);
+} kernels[] = {
+  {2, solve_fixed<2>},
+  {4, solve_fixed<4>},
+  {8, solve_fixed<8>},
+  {16, solve_fixed<16>},
+};
+
+// Independent subsystems are mostly tiny, and for those the general solvers' setup costs more than the elimination.
+class SmallSystemSolver : public DimensionlessSolver {
+public:
+  const char *name() const override {
+    return "small";
+  }
+
+  size_t estimate(const equation_system &system) const override {
+    for(const auto &kernel : kernels)
+      if(system.cols <= kernel.cols)
+        // It's all on the stack, besides the answer.
+        return sizeof(coefficient) * kernel.cols * (kernel.cols + 1) + sizeof(int) * system.cols;
+    return numeric_limits<size_t>::max();
+  }
+
+  bool solve(const equation_system &system, const vector<bool> *omit, vector<int> &forced, string &error) const override {
+    for(const auto &kernel : kernels)
+      if(system.cols <= kernel.cols) {
+        ++NumSmallSystems;
+        kernel.solve(system, omit, forced);
+        return true;
+      }
+    // Requested by name for something too big, so do it the general way.
+    return DimensionlessSolver::get("sparse")->solve(system, omit, forced, error);
+  }
+};
+}
+
+static RegisterSolver<SmallSystemSolver> small;
@@ -0,0 +1,32 @@
+#include "SolutionCache.h"
+
+using std::string;
+using std::unordered_map;
+
+SolutionCache::solution *SolutionCache::find(const string &key) {
+  auto entry = entries.find(key);
+  if(entry == entries.end())
+    return nullptr;
+  entry->second.second = true;
+  return &entry->second.first;
+}
+
+SolutionCache::solution &SolutionCache::insert(const string &key) {
+  auto &entry = entries[key];
+  entry.first = solution{{}, false, {}};
+  entry.second = true;
+  return entry.first;
+}
+
+void SolutionCache::prune() {
+  for(auto entry = entries.begin(); entry != entries.end(); )
+    if(entry->second.second) {
+      entry->second.second = false;
+      ++entry;
+    } else
+      entry = entries.erase(entry);
+}
+
+unordered_map<string, std::pair<SolutionCache::solution, bool>>::size_type SolutionCache::size() const {
+  return entries.size();
+}
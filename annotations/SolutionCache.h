@@ -0,0 +1,37 @@
+#ifndef SOLUTION_CACHE_H_
+#define SOLUTION_CACHE_H_
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Results for independent subsystems, keyed by their contents, so that re-analyzing a slightly changed module only
+// has to solve the parts that actually changed.
+class SolutionCache {
+public:
+  struct solution {
+    // Forced-zero columns, in the subsystem's own numbering.
+    std::vector<int> dimensionless;
+    // Whether blame has been worked out yet, and if so, the first of the subsystem's rows on each faulty line.
+    bool blamed;
+    std::vector<int> culprits;
+  };
+
+private:
+  // Each entry also notes whether it's been used since the last pruning.
+  std::unordered_map<std::string, std::pair<solution, bool>> entries;
+
+public:
+  // Returns nullptr if we haven't seen this subsystem before.
+  solution *find(const std::string &key);
+
+  solution &insert(const std::string &key);
+
+  // Forget everything that hasn't been used since last time.
+  void prune();
+
+  std::unordered_map<std::string, std::pair<solution, bool>>::size_type size() const;
+};
+
+#endif
@@ -1,14 +1,22 @@
 #include "TraceVariablesNg.h"
 
+#include <llvm/ADT/Statistic.h>
 #include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include "Diagnostics.h"
+
 using namespace llvm;
 using std::string;
 
+#define DEBUG_TYPE "tracevarsng"
+
+STATISTIC(NumSourceVariables, "Number of source variables found");
+STATISTIC(NumRegisterMappings, "Number of register to source variable mappings found");
+
 char TraceVariablesNg::ID = 0;
 
 static void scopecat(raw_string_ostream &stm, DIScope &scp) {
@@ -36,9 +44,11 @@ string TraceVariablesNg::str(const DIVariable &var, bool line_num) {
 TraceVariablesNg::TraceVariablesNg() :
     ModulePass(ID),
     vars(),
-    vals() {}
+    vals(),
+    grouping_timer("Source variable grouping", dimens_timers()) {}
 
 bool TraceVariablesNg::runOnModule(llvm::Module &mod) {
+  TimeRegion timing(TimePassesIsEnabled ? &grouping_timer : nullptr);
   NamedMDNode *meta_root = mod.getNamedMetadata("llvm.dbg.cu");
   if(!meta_root) {
     errs() << "ERROR: No compilation unit metadata found; did you compile with debugging symbols?\n";
@@ -63,6 +73,8 @@ bool TraceVariablesNg::runOnModule(llvm::Module &mod) {
             // This source variable is used in the program.
             insert(key, varOf(annot));
 
+  NumSourceVariables += vals.size();
+  NumRegisterMappings += vars.size();
   return false;
 }
 
@@ -94,12 +106,12 @@ Value *TraceVariablesNg::valOf(DbgInfoIntrinsic *inf) {
   else if(DbgValueInst *stor = dyn_cast<DbgValueInst>(inf))
     res = stor->getValue();
   else {
-    errs() << "WARNING: Tried to valOf() unhandled DbgDeclareInst: " << inf << '\n';
+    diags() << "WARNING: Tried to valOf() unhandled DbgDeclareInst: " << inf << '\n';
     return nullptr;
   }
 
   if(!res)
-    errs() << "INFO: Encountered unused variable: " << str(*varOf(inf), true) << '\n';
+    diags() << "INFO: Encountered unused variable: " << str(*varOf(inf), true) << '\n';
   else if(isa<Constant>(res))
     res = nullptr;
   return res;
@@ -114,7 +126,7 @@ DIVariable *TraceVariablesNg::varOf(DbgInfoIntrinsic *inf) {
   else if(DbgValueInst *stor = dyn_cast<DbgValueInst>(inf))
     res = stor->getVariable();
   else {
-    errs() << "WARNING: Tried to varOf() unhandled DbgDeclareInst: " << inf << '\n';
+    diags() << "WARNING: Tried to varOf() unhandled DbgDeclareInst: " << inf << '\n';
     return nullptr;
   }
 
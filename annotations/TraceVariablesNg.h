@@ -2,6 +2,7 @@
 #define TRACE_VARIABLES_NG_H_
 
 #include <llvm/Pass.h>
+#include <llvm/Support/Timer.h>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -29,6 +30,8 @@ public:
   void insert(llvm::Value *, llvm::DIVariable *);
 
 private:
+  llvm::Timer grouping_timer;
+
   // Get the register storing the variable in the program.
   static llvm::Value *valOf(llvm::DbgInfoIntrinsic *);
 
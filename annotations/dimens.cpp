@@ -0,0 +1,452 @@
+#include <llvm/ADT/Hashing.h>
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/InitializePasses.h>
+#include <llvm/PassRegistry.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/ManagedStatic.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/PrettyStackTrace.h>
+#include <llvm/Support/Signals.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "DimensionalAnalysis.h"
+#include "Diagnostics.h"
+#include "SolutionCache.h"
+
+using namespace llvm;
+using std::condition_variable;
+using std::deque;
+using std::lock_guard;
+using std::move;
+using std::mutex;
+using std::string;
+using std::thread;
+using std::unique_lock;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+
+static cl::list<string> inputs(cl::Positional, cl::ZeroOrMore, cl::desc("<input .bc or .ll files>"));
+static cl::opt<string> batch("batch", cl::desc("Also analyze every file listed (one per line) in this file, or - for stdin"), cl::value_desc("list"));
+static cl::opt<unsigned> jobs("j", cl::desc("Number of modules to analyze concurrently (default: 1, or one per core with -batch)"), cl::init(0));
+static cl::opt<string> output("o", cl::desc("Write the consolidated report to this file"), cl::value_desc("file"), cl::init("-"));
+static cl::opt<string> serve("serve", cl::desc("Stay resident, analyzing the module named by each request on this Unix domain socket"), cl::value_desc("socket"));
+static cl::opt<string> connect_to("connect", cl::desc("Have the server listening on this socket analyze the inputs"), cl::value_desc("socket"));
+static cl::opt<bool> quiet("quiet", cl::desc("Leave out the analysis's per-instruction trace and other progress messages, as with more than one worker"));
+
+namespace {
+struct loaded_module {
+  vector<string>::size_type order;
+  // Must outlive the module, so it's declared first.
+  unique_ptr<LLVMContext> context;
+  unique_ptr<Module> module;
+  string problems;
+};
+
+// Modules that the loader thread has finished parsing, waiting for a worker to pick them up.
+class module_queue {
+private:
+  mutex lock;
+  condition_variable changed;
+  deque<loaded_module> pending;
+  deque<loaded_module>::size_type capacity;
+  bool closed;
+
+public:
+  explicit module_queue(deque<loaded_module>::size_type capacity) :
+      lock(),
+      changed(),
+      pending(),
+      capacity(capacity),
+      closed(false) {}
+
+  // Blocks while the queue is full, so we never read too far ahead of the workers.
+  void push(loaded_module &&job) {
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this] {return pending.size() < capacity;});
+    pending.push_back(move(job));
+    changed.notify_all();
+  }
+
+  // Returns false once the queue has been closed and drained.
+  bool pop(loaded_module &job) {
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this] {return closed || pending.size();});
+    if(pending.empty())
+      return false;
+    job = move(pending.front());
+    pending.pop_front();
+    changed.notify_all();
+    return true;
+  }
+
+  void close() {
+    lock_guard<mutex> guard(lock);
+    closed = true;
+    changed.notify_all();
+  }
+};
+}
+
+// Pull in the bodies of the functions that have debugging information, since those are the only ones we can report on.
+static bool materialize_annotated(Module &module, raw_ostream &problems) {
+  for(MDNode *node : module.getNamedMetadata("llvm.dbg.cu")->operands())
+    if(DICompileUnit *comp_unit = dyn_cast<DICompileUnit>(node))
+      for(DISubprogram *subprogram : comp_unit->getSubprograms())
+        if(Function *function = subprogram->getFunction())
+          if(function->isMaterializable())
+            if(std::error_code err = function->materialize()) {
+              problems << "ERROR: Couldn't load body of " << function->getName() << ": " << err.message() << '\n';
+              return false;
+            }
+  return true;
+}
+
+static unique_ptr<Module> parse(unique_ptr<MemoryBuffer> buffer, const string &path, LLVMContext &context, raw_ostream &problems) {
+  unique_ptr<Module> res;
+  const unsigned char *begin = (const unsigned char *) buffer->getBufferStart();
+  const unsigned char *end = (const unsigned char *) buffer->getBufferEnd();
+  bool lazy = isBitcode(begin, end);
+  if(lazy) {
+    ErrorOr<unique_ptr<Module>> parsed = getLazyBitcodeModule(move(buffer), context);
+    if(!parsed) {
+      problems << "ERROR: Couldn't parse " << path << ": " << parsed.getError().message() << '\n';
+      return nullptr;
+    }
+    res = move(*parsed);
+  } else {
+    // Textual IR has to be parsed in its entirety.
+    SMDiagnostic diag;
+    res = parseIR(buffer->getMemBufferRef(), diag, context);
+    if(!res) {
+      diag.print(path.c_str(), problems);
+      return nullptr;
+    }
+  }
+
+  // Catch this here rather than letting TraceVariablesNg bring down the whole process.
+  if(!res->getNamedMetadata("llvm.dbg.cu")) {
+    problems << "ERROR: No compilation unit metadata found in " << path << "; did you compile with debugging symbols?\n";
+    return nullptr;
+  }
+  if(lazy && !materialize_annotated(*res, problems))
+    return nullptr;
+  return res;
+}
+
+static unique_ptr<Module> load(const string &path, LLVMContext &context, raw_ostream &problems) {
+  ErrorOr<unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFileOrSTDIN(path);
+  if(!buffer) {
+    problems << "ERROR: Couldn't read " << path << ": " << buffer.getError().message() << '\n';
+    return nullptr;
+  }
+  return parse(move(*buffer), path, context, problems);
+}
+
+static void analyze(Module &module, raw_ostream &report, SolutionCache *memo = nullptr) {
+  // The pass manager schedules TraceVariablesNg and the call graph for us.
+  legacy::PassManager passes;
+  DimensionalAnalysis *dimens = new DimensionalAnalysis();
+  dimens->reuse(memo);
+  dimens->report_early(&report);
+  passes.add(dimens);
+  passes.run(module);
+  dimens->print(report, &module);
+}
+
+static bool read_list(const string &path, vector<string> &into) {
+  ErrorOr<unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFileOrSTDIN(path);
+  if(!buffer) {
+    errs() << "ERROR: Couldn't read batch list " << path << ": " << buffer.getError().message() << '\n';
+    return false;
+  }
+
+  SmallVector<StringRef, 64> lines;
+  (*buffer)->getBuffer().split(lines, "\n", -1, false);
+  for(StringRef line : lines)
+    if(!(line = line.trim()).empty())
+      into.push_back(line.str());
+  return true;
+}
+
+namespace {
+// What the server remembers about each module it's been asked about.
+struct cached_module {
+  size_t digest;
+  string report;
+  SolutionCache solutions;
+};
+}
+
+static string reanalyze(const string &path, unordered_map<string, cached_module> &cache) {
+  ErrorOr<unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(path);
+  if(!buffer)
+    return "ERROR: Couldn't read " + path + ": " + buffer.getError().message() + '\n';
+
+  // Nothing to do if it hasn't changed at all.
+  cached_module &known = cache[path];
+  size_t digest = hash_value((*buffer)->getBuffer());
+  if(known.report.size() && known.digest == digest)
+    return known.report;
+
+  // Otherwise, only the independent subsystems that changed need to be solved again.
+  string report;
+  raw_string_ostream stm(report);
+  LLVMContext context;
+  if(unique_ptr<Module> module = parse(move(*buffer), path, context, stm)) {
+    analyze(*module, stm, &known.solutions);
+    known.solutions.prune();
+  }
+  stm.flush();
+  known.digest = digest;
+  known.report = report;
+  return report;
+}
+
+static bool unix_socket(const string &path, int &fd, sockaddr_un &addr) {
+  if(path.size() >= sizeof addr.sun_path) {
+    errs() << "ERROR: Socket path " << path << " is too long\n";
+    return false;
+  }
+  memset(&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+
+  if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+    errs() << "ERROR: Couldn't create socket: " << strerror(errno) << '\n';
+    return false;
+  }
+  return true;
+}
+
+// How long a client may take to send its request or accept its response before we move on to the next one.
+static const time_t client_timeout = 10;
+
+// Each request is the path of a module, terminated by a newline; the response is its report, terminated by hanging up.
+static int run_server(const string &path) {
+  // A client that hangs up early shouldn't take the server down with it.
+  signal(SIGPIPE, SIG_IGN);
+
+  int listener;
+  sockaddr_un addr;
+  if(!unix_socket(path, listener, addr))
+    return 1;
+  // Clear out any socket left behind by a previous server, but nothing else.
+  struct stat existing;
+  if(!lstat(path.c_str(), &existing)) {
+    if(!S_ISSOCK(existing.st_mode)) {
+      errs() << "ERROR: Refusing to replace " << path << ", which isn't a socket\n";
+      close(listener);
+      return 1;
+    }
+    unlink(path.c_str());
+  }
+  if(bind(listener, (sockaddr *) &addr, sizeof addr) || listen(listener, 16)) {
+    errs() << "ERROR: Couldn't listen on " << path << ": " << strerror(errno) << '\n';
+    return 1;
+  }
+  redirect_diags(&nulls());
+  errs() << "Listening on " << path << '\n';
+
+  unordered_map<string, cached_module> cache;
+  for(;;) {
+    int client = accept(listener, nullptr, nullptr);
+    if(client < 0) {
+      if(errno == EINTR)
+        continue;
+      errs() << "ERROR: Couldn't accept connection: " << strerror(errno) << '\n';
+      break;
+    }
+    timeval timeout = {client_timeout, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+
+    string request;
+    char chunk[256];
+    ssize_t got;
+    while(request.find('\n') == string::npos && (got = read(client, chunk, sizeof chunk)) > 0)
+      request.append(chunk, got);
+    string response;
+    if(request.find('\n') == string::npos)
+      response = "ERROR: Incomplete request\n";
+    else if((request = StringRef(request).split('\n').first.trim().str()).empty())
+      response = "ERROR: Empty request\n";
+    else
+      response = reanalyze(request, cache);
+    for(const char *next = response.data(), *end = next + response.size(); next < end; ) {
+      ssize_t sent = write(client, next, end - next);
+      if(sent <= 0)
+        break;
+      next += sent;
+    }
+    close(client);
+  }
+  close(listener);
+  return 1;
+}
+
+static int run_client(const string &path, const vector<string> &paths, raw_ostream &report) {
+  int status = 0;
+  for(const string &each : paths) {
+    // The server has its own working directory.
+    SmallString<256> absolute(each);
+    sys::fs::make_absolute(absolute);
+
+    int server;
+    sockaddr_un addr;
+    if(!unix_socket(path, server, addr))
+      return 1;
+    if(connect(server, (sockaddr *) &addr, sizeof addr)) {
+      errs() << "ERROR: Couldn't connect to " << path << ": " << strerror(errno) << '\n';
+      close(server);
+      return 1;
+    }
+
+    string request = absolute.str().str() + '\n';
+    if(write(server, request.data(), request.size()) != (ssize_t) request.size()) {
+      errs() << "ERROR: Couldn't send request to " << path << '\n';
+      status = 1;
+    }
+    if(paths.size() > 1)
+      report << "==> " << each << " <==\n";
+    char chunk[4096];
+    ssize_t got;
+    while((got = read(server, chunk, sizeof chunk)) > 0)
+      report.write(chunk, got);
+    close(server);
+  }
+  return status;
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram stack_trace(argc, argv);
+  llvm_shutdown_obj shutdown;
+
+  PassRegistry &registry = *PassRegistry::getPassRegistry();
+  initializeCore(registry);
+  initializeAnalysis(registry);
+  // Home of the call graph, which the analysis requires.
+  initializeIPA(registry);
+
+  cl::ParseCommandLineOptions(argc, argv, "Dimentia: static dimensional analysis\n");
+
+  if(serve.getNumOccurrences())
+    return run_server(serve);
+
+  vector<string> paths(inputs.begin(), inputs.end());
+  if(batch.getNumOccurrences() && !read_list(batch, paths))
+    return 1;
+  if(paths.empty()) {
+    errs() << "ERROR: No input files\n";
+    return 1;
+  }
+
+  unsigned workers = jobs;
+  if(!workers)
+    workers = batch.getNumOccurrences() ? thread::hardware_concurrency() : 1;
+  if(!workers)
+    workers = 1;
+  if(workers > paths.size())
+    workers = paths.size();
+
+  std::error_code err;
+  raw_fd_ostream report(output, err, sys::fs::F_None);
+  if(err) {
+    errs() << "ERROR: Couldn't open " << output << ": " << err.message() << '\n';
+    return 1;
+  }
+
+  if(connect_to.getNumOccurrences())
+    return run_client(connect_to, paths, report);
+
+  // One I/O thread reads and parses ahead, keeping the workers fed without holding every module in memory at once.
+  vector<string> reports(paths.size());
+  vector<char> failed(paths.size());
+  module_queue parsed(workers);
+  thread loader([&] {
+    for(vector<string>::size_type order = 0, count = paths.size(); order < count; ++order) {
+      loaded_module job;
+      job.order = order;
+      job.context.reset(new LLVMContext());
+      raw_string_ostream problems(job.problems);
+      job.module = load(paths[order], *job.context, problems);
+      problems.flush();
+      parsed.push(move(job));
+    }
+    parsed.close();
+  });
+
+  auto heading = [&](vector<string>::size_type order, raw_ostream &stream) {
+    if(paths.size() > 1)
+      stream << "==> " << paths[order] << " <==\n";
+  };
+
+  vector<thread> pool;
+  for(unsigned worker = 0; worker < workers; ++worker)
+    pool.emplace_back([&] {
+      // Per-instruction chatter from concurrent analyses would be an unreadable jumble.
+      if(workers > 1 || quiet)
+        redirect_diags(&nulls());
+
+      loaded_module job;
+      while(parsed.pop(job)) {
+        // A lone worker finishes the modules in order, so it can write straight to the report, and anything printed
+        // ahead of the rest (such as with -dimens-stream) shows up right away.
+        raw_string_ostream stm(reports[job.order]);
+        raw_ostream &out = workers > 1 ? (raw_ostream &) stm : report;
+        if(workers == 1)
+          heading(job.order, report);
+        out << job.problems;
+        if(job.module)
+          analyze(*job.module, out);
+        else
+          failed[job.order] = true;
+        out.flush();
+        job.module.reset();
+        job.context.reset();
+      }
+    });
+
+  loader.join();
+  for(thread &worker : pool)
+    worker.join();
+
+  int status = 0;
+  vector<string>::size_type failures = 0;
+  for(vector<string>::size_type order = 0, count = paths.size(); order < count; ++order) {
+    if(workers > 1) {
+      heading(order, report);
+      report << reports[order];
+    }
+    if(failed[order]) {
+      ++failures;
+      status = 1;
+    }
+  }
+  if(paths.size() > 1)
+    errs() << "Analyzed " << paths.size() - failures << " of " << paths.size() << " modules using " << workers << " workers\n";
+
+  return status;
+}
@@ -0,0 +1,393 @@
+#include <llvm/InitializePasses.h>
+#include <llvm/PassRegistry.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/ManagedStatic.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/PrettyStackTrace.h>
+#include <llvm/Support/Signals.h>
+#include <llvm/Support/raw_ostream.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <random>
+#include <sstream>
+
+#include "DimensionlessSolver.h"
+#include "Presolve.h"
+
+using namespace llvm;
+using std::map;
+using std::move;
+using std::string;
+using std::vector;
+
+static cl::list<string> inputs(cl::Positional, cl::ZeroOrMore, cl::desc("<systems captured with dimens -dimens-matrix>"));
+static cl::opt<unsigned> random_count("random", cl::desc("Also check this many randomly generated systems"), cl::init(0));
+static cl::opt<unsigned> seed("seed", cl::desc("Seed for the random systems"), cl::init(1));
+static cl::opt<unsigned> max_cols("max-cols", cl::desc("Largest number of variables in a random system"), cl::init(60));
+static cl::opt<bool> adversarial("adversarial", cl::desc("Also check a fixed set of systems built to trip up solvers and presolve"));
+static cl::opt<unsigned> rows_per_line("rows-per-line", cl::desc("Number of consecutive rows standing in for each source line when comparing blame"), cl::init(3));
+static cl::opt<unsigned> max_lines("max-lines", cl::desc("Compare blame on at most this many lines per system (0 to skip blame)"), cl::init(64));
+static cl::opt<string> reference_name("reference", cl::desc("Engine whose results the others must match"), cl::init("dense"));
+static cl::opt<string> output("o", cl::desc("Write the per-engine measurements as CSV to this file"), cl::value_desc("file"), cl::init("-"));
+
+namespace {
+struct named_system {
+  string name;
+  equation_system system;
+};
+
+// One solver, with or without presolve in front of it.
+struct engine {
+  string name;
+  const DimensionlessSolver *solver;
+  bool presolve;
+
+  bool solve(const equation_system &system, const vector<bool> *omit, vector<int> &forced, string &error) const {
+    if(!presolve)
+      return solver->solve(system, omit, forced, error);
+    Presolve reduced(system, omit);
+    if(!solver->solve(reduced.reduced(), nullptr, forced, error))
+      return false;
+    forced = reduced.expand(forced);
+    return true;
+  }
+
+  // Whether the solver will take this system itself, rather than rejecting it or quietly handing it to another.
+  bool accepts(const equation_system &system) const {
+    if(!presolve)
+      return solver->estimate(system) != (std::size_t) -1;
+    Presolve reduced(system);
+    return solver->estimate(reduced.reduced()) != (std::size_t) -1;
+  }
+};
+
+// What an engine made of a system.
+struct verdict {
+  vector<int> forced;
+  // Lines whose removal frees a forced column, as the analysis's blame would flag them.
+  vector<int> flagged;
+  double seconds;
+  long peak_kib;
+  bool crashed;
+};
+}
+
+static equation_system::row make_row(map<equation_system::column, int> &&terms) {
+  equation_system::row res;
+  for(const auto &term : terms)
+    if(term.second)
+      res.push_back(term);
+  return res;
+}
+
+static bool read_matrix_market(const string &path, equation_system &system) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFileOrSTDIN(path);
+  if(!buffer) {
+    errs() << "ERROR: Couldn't read " << path << ": " << buffer.getError().message() << '\n';
+    return false;
+  }
+
+  std::istringstream in((*buffer)->getBuffer().str());
+  string line;
+  while(std::getline(in, line) && (line.empty() || line[0] == '%'));
+  std::istringstream header(line);
+  unsigned long rows, cols, nonzeros;
+  if(!(header >> rows >> cols >> nonzeros)) {
+    errs() << "ERROR: " << path << " isn't in Matrix Market coordinate format\n";
+    return false;
+  }
+
+  vector<map<equation_system::column, int>> terms(rows);
+  for(unsigned long entry = 0; entry < nonzeros; ++entry) {
+    unsigned long row, col;
+    int coeff;
+    if(!(in >> row >> col >> coeff) || !row || row > rows || !col || col > cols) {
+      errs() << "ERROR: Malformed entry " << entry + 1 << " in " << path << '\n';
+      return false;
+    }
+    terms[row - 1][col - 1] += coeff;
+  }
+
+  system.cols = cols;
+  system.rows.clear();
+  for(auto &each : terms)
+    system.rows.push_back(make_row(move(each)));
+  return true;
+}
+
+// Rows of a few terms each with small exponents, like the ones programs produce, including some repeats.
+static equation_system random_system(std::mt19937 &rng) {
+  equation_system res;
+  res.cols = 1 + rng() % max_cols;
+  unsigned rows = rng() % (2 * res.cols);
+  for(unsigned row = 0; row < rows; ++row) {
+    map<equation_system::column, int> terms;
+    for(unsigned term = 0, count = 1 + rng() % 4; term < count; ++term)
+      terms[rng() % res.cols] += (int) (rng() % 5) - 2;
+    res.rows.push_back(make_row(move(terms)));
+    if(rng() % 8 == 0)
+      res.rows.push_back(res.rows.back());
+  }
+  return res;
+}
+
+static vector<named_system> adversarial_systems() {
+  vector<named_system> res;
+  auto add = [&res](const string &name, equation_system::column cols, vector<map<equation_system::column, int>> &&rows) {
+    named_system each;
+    each.name = name;
+    each.system.cols = cols;
+    for(auto &terms : rows)
+      each.system.rows.push_back(make_row(move(terms)));
+    res.push_back(move(each));
+  };
+
+  // Nothing at all, and nothing but empty rows.
+  add("empty", 0, {});
+  add("empty-rows", 4, {{}, {}, {}});
+
+  // A long chain of equalities, one end of which is pinned, so everything must be forced one step at a time.
+  vector<map<equation_system::column, int>> chain;
+  for(equation_system::column col = 0; col < 200; ++col)
+    chain.push_back({{col, 1}, {col + 1, -1}});
+  chain.push_back({{200, 1}});
+  add("pinned-chain", 201, move(chain));
+
+  // A ratio of like quantities: c appears only once, but it's forced all the same.
+  add("cancelling-ratio", 3, {{{0, 1}, {1, -1}, {2, 1}}, {{1, 1}, {2, -1}}});
+  // ...and one that truly is free, because the other factor is unconstrained.
+  add("free-ratio", 3, {{{0, 1}, {1, -1}, {2, 1}}, {{1, 1}}});
+
+  // Repeated doublings, whose solutions span many orders of magnitude and strain floating-point rank decisions.
+  vector<map<equation_system::column, int>> doublings;
+  for(equation_system::column col = 0; col < 40; ++col)
+    doublings.push_back({{col, 1}, {col + 1, -2}});
+  doublings.push_back({{0, 1}, {40, -1}});
+  add("doublings", 41, move(doublings));
+
+  // Scalar multiples and negations of the same rows, which must neither add rank nor be mistaken for new constraints.
+  add("multiples", 3, {{{0, 1}, {1, -1}}, {{0, -3}, {1, 3}}, {{0, 2}, {1, -2}}, {{1, 1}, {2, 1}}});
+
+  // A dense block of rank one less than its width, so exactly one direction survives.
+  vector<map<equation_system::column, int>> block;
+  for(equation_system::column row = 0; row < 30; ++row) {
+    map<equation_system::column, int> terms;
+    for(equation_system::column col = 0; col < 30; ++col)
+      terms[col] = col == row ? 1 : 0;
+    terms[30] = -1;
+    block.push_back(move(terms));
+  }
+  add("rank-deficient-block", 31, move(block));
+  return res;
+}
+
+// Solve in a child process, so that each engine's peak memory can be measured on its own and a crash is contained.
+// An engine that reports failure counts as having crashed, after saying why.
+static verdict measure(const engine &how, const equation_system &system, long baseline_kib) {
+  verdict res = verdict();
+  int channel[2];
+  if(pipe(channel)) {
+    res.crashed = true;
+    return res;
+  }
+
+  pid_t child = fork();
+  if(!child) {
+    close(channel[0]);
+    auto start = std::chrono::steady_clock::now();
+    vector<int> forced;
+    string error;
+    if(!how.solve(system, nullptr, forced, error)) {
+      errs() << error << '\n';
+      _exit(1);
+    }
+
+    // Blame each line in turn, just as getBadEqns does.
+    vector<int> flagged;
+    unsigned lines = (system.rows.size() + rows_per_line - 1) / rows_per_line;
+    for(unsigned line = 0; line < std::min<unsigned>(lines, max_lines); ++line) {
+      vector<bool> omit(system.rows.size());
+      for(unsigned row = line * rows_per_line; row < std::min<unsigned>((line + 1) * rows_per_line, system.rows.size()); ++row)
+        omit[row] = true;
+      vector<int> remaining;
+      if(!how.solve(system, &omit, remaining, error)) {
+        errs() << error << '\n';
+        _exit(1);
+      }
+      if(!std::includes(remaining.begin(), remaining.end(), forced.begin(), forced.end()))
+        flagged.push_back(line);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Send back the lengths, then the contents.
+    std::size_t sizes[] = {forced.size(), flagged.size()};
+    bool ok = write(channel[1], &seconds, sizeof seconds) == sizeof seconds &&
+        write(channel[1], sizes, sizeof sizes) == sizeof sizes &&
+        write(channel[1], forced.data(), sizeof(int) * forced.size()) == (ssize_t) (sizeof(int) * forced.size()) &&
+        write(channel[1], flagged.data(), sizeof(int) * flagged.size()) == (ssize_t) (sizeof(int) * flagged.size());
+    _exit(!ok);
+  }
+  close(channel[1]);
+
+  // Drain the pipe before waiting, lest a big answer fill it up and deadlock us.
+  string received;
+  char buffer[4096];
+  for(ssize_t got; (got = read(channel[0], buffer, sizeof buffer)) > 0;)
+    received.append(buffer, got);
+  close(channel[0]);
+
+  int status;
+  struct rusage usage;
+  res.crashed = child < 0 || wait4(child, &status, 0, &usage) != child || !WIFEXITED(status) || WEXITSTATUS(status);
+  if(res.crashed)
+    return res;
+  res.peak_kib = std::max(0L, (long) usage.ru_maxrss - baseline_kib);
+
+  const char *next = received.data();
+  std::size_t sizes[2];
+  if(received.size() < sizeof res.seconds + sizeof sizes) {
+    res.crashed = true;
+    return res;
+  }
+  memcpy(&res.seconds, next, sizeof res.seconds);
+  next += sizeof res.seconds;
+  memcpy(sizes, next, sizeof sizes);
+  next += sizeof sizes;
+  if(received.size() != sizeof res.seconds + sizeof sizes + sizeof(int) * (sizes[0] + sizes[1])) {
+    res.crashed = true;
+    return res;
+  }
+  res.forced.assign((const int *) next, (const int *) next + sizes[0]);
+  next += sizeof(int) * sizes[0];
+  res.flagged.assign((const int *) next, (const int *) next + sizes[1]);
+  return res;
+}
+
+// The peak memory of a child that does nothing, which is the part that's really the parent's.
+static long baseline() {
+  pid_t child = fork();
+  if(!child)
+    _exit(0);
+  int status;
+  struct rusage usage;
+  return child > 0 && wait4(child, &status, 0, &usage) == child ? usage.ru_maxrss : 0;
+}
+
+static void print_columns(raw_ostream &stream, const vector<int> &cols) {
+  for(int col : cols)
+    stream << ' ' << col;
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram stack_trace(argc, argv);
+  llvm_shutdown_obj shutdown;
+
+  // Register the same passes as dimens, so that the two accept the same pass manager options.
+  PassRegistry &registry = *PassRegistry::getPassRegistry();
+  initializeCore(registry);
+  initializeAnalysis(registry);
+  initializeIPA(registry);
+
+  cl::ParseCommandLineOptions(argc, argv,
+      "Dimentia solver oracle: checks every solver, with and without presolve, against the reference\n");
+
+  vector<engine> engines;
+  for(const DimensionlessSolver *solver : DimensionlessSolver::all()) {
+    engines.push_back({solver->name(), solver, false});
+    engines.push_back({string(solver->name()) + "+presolve", solver, true});
+  }
+  auto reference = std::find_if(engines.begin(), engines.end(), [](const engine &each) {return each.name == reference_name;});
+  if(reference == engines.end()) {
+    errs() << "ERROR: No engine named " << reference_name << '\n';
+    return 1;
+  }
+  std::rotate(engines.begin(), reference, reference + 1);
+
+  vector<named_system> systems;
+  for(const string &path : inputs) {
+    named_system each;
+    each.name = path;
+    if(!read_matrix_market(path, each.system))
+      return 1;
+    systems.push_back(move(each));
+  }
+  if(adversarial)
+    for(named_system &each : adversarial_systems())
+      systems.push_back(move(each));
+  std::mt19937 rng(seed);
+  for(unsigned count = 0; count < random_count; ++count)
+    systems.push_back({"random-" + std::to_string(count), random_system(rng)});
+  if(systems.empty()) {
+    errs() << "ERROR: Nothing to check; give some captured systems, -random=<count> or -adversarial\n";
+    return 1;
+  }
+
+  std::error_code err;
+  raw_fd_ostream csv(output, err, sys::fs::F_Text);
+  if(err) {
+    errs() << "ERROR: Couldn't open " << output << ": " << err.message() << '\n';
+    return 1;
+  }
+  csv << "system,rows,cols,nonzeros,engine,seconds,peak_kib,forced,flagged,agrees\n";
+
+  long base = baseline();
+  unsigned disagreements = 0;
+  for(const named_system &each : systems) {
+    const equation_system &system = each.system;
+    if(!engines.front().accepts(system)) {
+      errs() << "WARNING: Skipping " << each.name << ", which " << reference_name << " can't solve\n";
+      continue;
+    }
+
+    verdict expected;
+    for(const engine &how : engines) {
+      // Its time and memory would really be some other solver's.
+      if(!how.accepts(system))
+        continue;
+      verdict got = measure(how, system, base);
+      if(&how == &engines.front())
+        expected = got;
+      bool agrees = !got.crashed && !expected.crashed && got.forced == expected.forced && got.flagged == expected.flagged;
+
+      csv << each.name << ',' << system.rows.size() << ',' << system.cols << ',' << system.nonzeros() << ','
+          << how.name << ',';
+      if(got.crashed)
+        csv << ",,,,";
+      else
+        csv << format("%.6f", got.seconds) << ',' << got.peak_kib << ',' << got.forced.size() << ','
+            << got.flagged.size() << ',';
+      csv << (agrees ? "yes" : "no") << '\n';
+
+      if(!agrees) {
+        ++disagreements;
+        errs() << "MISMATCH: " << how.name << " on " << each.name;
+        if(got.crashed)
+          errs() << " crashed or failed\n";
+        else {
+          errs() << "\n  forced:";
+          print_columns(errs(), got.forced);
+          errs() << "\n  versus:";
+          print_columns(errs(), expected.forced);
+          errs() << "\n  flagged lines:";
+          print_columns(errs(), got.flagged);
+          errs() << "\n  versus:";
+          print_columns(errs(), expected.flagged);
+          errs() << '\n';
+        }
+      }
+    }
+  }
+
+  if(disagreements)
+    errs() << disagreements << " results disagreed with " << reference_name << '\n';
+  return disagreements != 0;
+}
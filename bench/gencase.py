@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Generate a synthetic C program for benchmarking the dimens pass.
+
+The program is dimensionally consistent except for the requested number of injected bugs, each of which forces one
+variable to be dimensionless.  Every function calls the one generated before it, so call chains are as deep as the
+number of functions.
+"""
+
+import argparse
+import random
+import sys
+
+BASE_UNITS = 3
+
+
+def dims_mul(lhs, rhs, sign=1):
+    return tuple(l + sign * r for l, r in zip(lhs, rhs))
+
+
+def unit(index):
+    return tuple(1 if i == index % BASE_UNITS else 0 for i in range(BASE_UNITS))
+
+
+class Function:
+    def __init__(self, gen, index):
+        self.gen = gen
+        self.name = 'fn%d' % index
+        self.index = index
+        self.lines = []
+        self.vars = []  # (name, dims)
+        self.next_var = 0
+
+    def fresh(self, dims, expr):
+        name = 'v%d' % self.next_var
+        self.next_var += 1
+        self.lines.append('  double %s = %s;' % (name, expr))
+        self.vars.append((name, dims))
+        return name
+
+    def pick(self, dims=None):
+        pool = [v for v in self.vars if dims is None or v[1] == dims]
+        return self.gen.rng.choice(pool) if pool else None
+
+    def additive(self):
+        name, dims = self.pick()
+        other = self.pick(dims)[0]
+        return self.fresh(dims, '%s %s %s' % (name, self.gen.rng.choice('+-'), other))
+
+    def multiplicative(self):
+        lname, ldims = self.pick()
+        rname, rdims = self.pick()
+        if self.gen.rng.random() < 0.5:
+            return self.fresh(dims_mul(ldims, rdims), '%s * %s' % (lname, rname))
+        return self.fresh(dims_mul(ldims, rdims, -1), '%s / %s' % (lname, rname))
+
+    def field_access(self):
+        struct = self.gen.rng.randrange(len(self.gen.structs))
+        field = self.gen.rng.randrange(self.gen.structs[struct])
+        dims = self.gen.field_dims(struct, field)
+        source = self.pick(dims)
+        if source and self.gen.rng.random() < 0.5:
+            self.lines.append('  rec%d.f%d = %s;' % (struct, field, source[0]))
+        else:
+            self.fresh(dims, 'rec%d.f%d' % (struct, field))
+
+    def bug(self):
+        # deg(a) = deg(a) + deg(b) can only hold if b is dimensionless.
+        for _ in range(16):
+            aname, adims = self.pick()
+            bname, bdims = self.pick()
+            if any(bdims):
+                break
+        self.fresh(adims, '%s + %s * %s' % (aname, aname, bname))
+
+    def emit(self, variables, bugs, args):
+        self.vars = [('p0', unit(0)), ('p1', unit(1))]
+        rng = self.gen.rng
+        bug_at = set(rng.sample(range(variables), min(bugs, variables)))
+        for statement in range(variables):
+            roll = rng.random()
+            if statement in bug_at:
+                self.bug()
+            elif roll < args.struct_density:
+                self.field_access()
+            elif roll < args.struct_density + (1 - args.struct_density) * args.mul_share:
+                self.multiplicative()
+            else:
+                self.additive()
+        if self.index:
+            first = self.pick(unit(0))[0]
+            second = self.pick(unit(1))[0]
+            self.fresh(unit(0), 'fn%d(%s, %s)' % (self.index - 1, first, second))
+        result = self.pick(unit(0))[0]
+        body = '\n'.join(self.lines)
+        return 'double %s(double p0, double p1) {\n%s\n  return %s;\n}\n' % (self.name, body, result)
+
+
+class Generator:
+    def __init__(self, args):
+        self.rng = random.Random(args.seed)
+        fields = max(1, int(round(args.struct_density * args.variables)))
+        self.structs = [fields] * max(1, args.functions // 16)
+
+    def field_dims(self, struct, field):
+        return unit(struct + field)
+
+    def program(self, args):
+        out = ['// Generated by gencase.py %s' % ' '.join(sys.argv[1:]), '']
+        for struct, fields in enumerate(self.structs):
+            members = ' '.join('double f%d;' % f for f in range(fields))
+            out.append('struct rec%d { %s } rec%d;' % (struct, members, struct))
+        out.append('')
+
+        functions = [Function(self, index) for index in range(args.functions)]
+        bugs = [0] * args.functions
+        for _ in range(args.bugs):
+            bugs[self.rng.randrange(args.functions)] += 1
+        for function in functions:
+            out.append(function.emit(args.variables, bugs[function.index], args))
+
+        out.append('int main(void) {')
+        out.append('  return fn%d(1.0, 2.0) > 0;' % (args.functions - 1))
+        out.append('}')
+        return '\n'.join(out) + '\n'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--functions', type=int, default=16, help='number of functions (and call chain depth)')
+    parser.add_argument('--variables', type=int, default=32, help='local variables per function')
+    parser.add_argument('--struct-density', type=float, default=0.1,
+                        help='fraction of statements that access a struct field')
+    parser.add_argument('--mul-share', type=float, default=0.3,
+                        help='fraction of the remaining expressions that multiply or divide')
+    parser.add_argument('--bugs', type=int, default=1, help='number of injected dimensional bugs')
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args()
+    if args.functions < 1 or args.variables < 1:
+        parser.error('need at least one function and one variable')
+    sys.stdout.write(Generator(args).program(args))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Measure how the dimens analysis scales with program size and with the number of worker threads.
+
+Each data point is a program produced by gencase.py and compiled to mem2reg'd bitcode through tests/Makefile.
+Per-phase wall times come from the analysis's -time-passes report and are written as CSV, one row per phase.
+Every run is given a memory budget, since the dense solver can't take the whole of the larger programs, and is run
+with -quiet, so that the single-worker points don't pay for the per-instruction trace that the others leave out.
+"""
+
+import argparse
+import csv
+import os
+import re
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+TESTS_MAKEFILE = os.path.join(HERE, '..', 'tests', 'Makefile')
+TIMING = re.compile(r'(\d+\.\d+) \(\s*\d+\.\d+%\)')
+INSTRUCTION = re.compile(r'^  (%\S+ = )?[a-z]')
+
+
+def generate(workdir, tag, args, functions, seed):
+    source = os.path.join(workdir, tag + '.c')
+    with open(source, 'w') as out:
+        subprocess.check_call([sys.executable, os.path.join(HERE, 'gencase.py'),
+                               '--functions', str(functions), '--variables', str(args.variables),
+                               '--struct-density', str(args.struct_density), '--mul-share', str(args.mul_share),
+                               '--bugs', str(args.bugs), '--seed', str(seed)], stdout=out)
+    subprocess.check_call(['make', '-s', '-C', workdir, '-f', TESTS_MAKEFILE, tag + '.bc'])
+    return os.path.join(workdir, tag + '.bc')
+
+
+def count_instructions(bitcode, llvm_dis):
+    listing = subprocess.check_output([llvm_dis, bitcode, '-o', '-'], universal_newlines=True)
+    return sum(1 for line in listing.splitlines() if INSTRUCTION.match(line))
+
+
+def parse_timers(report):
+    """Map each timer named in a -time-passes style report to its wall time."""
+    phases = {}
+    for line in report.splitlines():
+        times = list(TIMING.finditer(line))
+        if not times:
+            continue
+        name = line[times[-1].end():].strip()
+        if name and name != 'Total':
+            phases[name] = phases.get(name, 0.0) + float(times[-1].group(1))
+    return phases
+
+
+def run(dimens, inputs, threads, extra):
+    command = [dimens, '-time-passes', '-quiet'] + extra
+    if len(inputs) > 1:
+        listing = inputs[0] + '.list'
+        with open(listing, 'w') as out:
+            out.write('\n'.join(inputs) + '\n')
+        command += ['-batch', listing, '-j', str(threads)]
+    else:
+        command += inputs
+    start = time.monotonic()
+    proc = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, universal_newlines=True)
+    elapsed = time.monotonic() - start
+    if proc.returncode:
+        sys.stderr.write(proc.stderr[-4000:])
+        raise SystemExit('dimens failed on %s' % ' '.join(inputs))
+    phases = parse_timers(proc.stderr)
+    phases['total (wall)'] = elapsed
+    return phases
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--dimens', default=os.path.join(HERE, '..', 'annotations', 'dimens'))
+    parser.add_argument('--llvm-dis', default='llvm-dis-3.7')
+    parser.add_argument('--workdir', default=os.path.join(HERE, 'cases'))
+    parser.add_argument('--functions', type=int, nargs='+', default=[16, 64, 256, 1024, 4096, 16384],
+                        help='program sizes, in functions, for the size scaling curve')
+    parser.add_argument('--variables', type=int, default=64)
+    parser.add_argument('--struct-density', type=float, default=0.1)
+    parser.add_argument('--mul-share', type=float, default=0.3)
+    parser.add_argument('--bugs', type=int, default=4)
+    parser.add_argument('--threads', type=int, nargs='+', default=[1, 2, 4, 8],
+                        help='worker counts for the thread scaling curve')
+    parser.add_argument('--modules', type=int, default=16, help='modules analyzed together for the thread curve')
+    parser.add_argument('--mem-budget', type=int, default=4096,
+                        help='MiB passed as -dimens-mem-budget, so the larger programs are split up (0 for no budget)')
+    parser.add_argument('--dimens-args', default='', help='extra options passed through to dimens')
+    parser.add_argument('-o', '--output', default='-')
+    args = parser.parse_args()
+
+    os.makedirs(args.workdir, exist_ok=True)
+    extra = ['-dimens-mem-budget=%d' % args.mem_budget] + args.dimens_args.split()
+    out = sys.stdout if args.output == '-' else open(args.output, 'w', newline='')
+    table = csv.writer(out)
+    table.writerow(['curve', 'functions', 'modules', 'instructions', 'threads', 'phase', 'seconds'])
+
+    for functions in args.functions:
+        bitcode = generate(args.workdir, 'size-%d' % functions, args, functions, 0)
+        instructions = count_instructions(bitcode, args.llvm_dis)
+        for phase, seconds in sorted(run(args.dimens, [bitcode], 1, extra).items()):
+            table.writerow(['size', functions, 1, instructions, 1, phase, '%.6f' % seconds])
+        out.flush()
+
+    functions = args.functions[len(args.functions) // 2]
+    modules = [generate(args.workdir, 'threads-%d-%d' % (functions, seed), args, functions, seed)
+               for seed in range(args.modules)]
+    instructions = sum(count_instructions(bitcode, args.llvm_dis) for bitcode in modules)
+    for threads in args.threads:
+        for phase, seconds in sorted(run(args.dimens, modules, threads, extra).items()):
+            table.writerow(['threads', functions, len(modules), instructions, threads, phase, '%.6f' % seconds])
+        out.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,17 @@
+// Values that only meet in heap memory reached through different pointers
+
+#include <stdlib.h>
+
+static double *last(double *readings, int count) {
+  return readings + count - 1;
+}
+
+double area(double width, double height) {
+  double *readings = malloc(4 * sizeof *readings);
+  for(int at = 0; at < 4; ++at)
+    readings[at] = width;
+  *last(readings, 4) += width * height;
+  double result = readings[0];
+  free(readings);
+  return result;
+}
@@ -0,0 +1,17 @@
+// Dimensions flowing through function parameters and return values
+
+static int area(int width, int height) {
+  return width * height;
+}
+
+static int perimeter(int width, int height) {
+  return width + height + width + height;
+}
+
+int main(void) {
+  int width = 3, height = 4;
+  int size = area(width, height);
+  int fence = perimeter(width, height);
+  int total = size + fence;
+  return total;
+}
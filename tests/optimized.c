@@ -0,0 +1,18 @@
+// Selects, conversions and math intrinsics, which is what optimized IR is made of
+
+#include <math.h>
+
+double drift(double position, double velocity, int steps) {
+  double speed = fabs(velocity);
+  double travel = speed * steps;
+  double ahead = position > 0 ? position + travel : position - travel;
+  return ahead + speed * travel;
+}
+
+// The vectorizer turns this into vector loads, adds and shuffles, all of whose lanes share the lengths' dimensions.
+int total(const int *lengths, int count) {
+  int sum = 0;
+  for(int each = 0; each < count; ++each)
+    sum += lengths[each];
+  return sum;
+}
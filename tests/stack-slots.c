@@ -0,0 +1,15 @@
+// Locals that unoptimized IR keeps in stack slots, loaded and stored in several blocks
+
+int main(int argc, char **argv) {
+  (void) argv;
+  int elapsed = 0, distance = 0;
+  int speed = argc;
+  for(int tick = 0; tick < 10; ++tick) {
+    if(tick % 2)
+      distance += speed;
+    else
+      distance += speed * tick;
+    elapsed += tick;
+  }
+  return distance / elapsed;
+}
@@ -0,0 +1,13 @@
+// Instantiations of one template, whose equations are worked out once and shared
+
+template<typename T>
+static T grow(T amount, T rate) {
+  amount += amount * rate;
+  return amount;
+}
+
+int main() {
+  int people = grow(30, 2);
+  double money = grow(1.5, 0.25);
+  return people + (int) money;
+}